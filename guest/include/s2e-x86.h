@@ -182,6 +182,59 @@ static inline void s2e_make_concolic(void *buf, int size, const char *name)
 }
 
 
+/** Fill buffer with concolic values taken from the SeedBatch corpus.
+ *  Execution continues in one state per seed file, each seed being
+ *  truncated or zero-padded to size.
+ *
+ * NOTE: This requires the SeedBatch plugin. */
+static inline void s2e_seed_batch_make_concolic(void *buf, int size, const char *name)
+{
+    __s2e_touch_string(name);
+    __s2e_touch_buffer(buf, size);
+    __asm__ __volatile__(
+#ifdef __x86_64__
+        "push %%rbx\n"
+        "mov %%rdx, %%rbx\n"
+#else
+        "pushl %%ebx\n"
+        "movl %%edx, %%ebx\n"
+#endif
+        S2E_INSTRUCTION_SIMPLE(B0)
+#ifdef __x86_64__
+        "pop %%rbx\n"
+#else
+        "popl %%ebx\n"
+#endif
+        : : "a" (buf), "d" (size), "c" (name) : "memory"
+    );
+}
+
+/** Fetch the next input of the fork server into buf and return its size.
+ *  The first call starts the server, later calls in a run end that run.
+ *
+ * NOTE: This requires the ForkServer plugin. */
+static inline int s2e_fork_server_input(void *buf, int size)
+{
+    int result;
+    __s2e_touch_buffer(buf, size);
+    __asm__ __volatile__(
+        S2E_INSTRUCTION_SIMPLE(B1)
+        : "=a" (result) : "a" (buf), "c" (size) : "memory"
+    );
+    return result;
+}
+
+/** Report a result code for the current fork server run.
+ *
+ * NOTE: This requires the ForkServer plugin. */
+static inline void s2e_fork_server_report(unsigned result)
+{
+    __asm__ __volatile__(
+        S2E_INSTRUCTION_COMPLEX(B1, 01)
+        : : "a" (result)
+    );
+}
+
 /** Adds a constraint to the current state. The constraint must be satisfiable. */
 static inline void s2e_assume(int expression)
 {
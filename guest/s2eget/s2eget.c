@@ -45,8 +45,17 @@
 #include <fcntl.h>
 #include <errno.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
 #include "s2e.h"
 
+/* HostFiles serves a whole read with one custom instruction, so a large
+   buffer amortizes the guest/host round trips. The buffer is locked in
+   memory so that the host never finds a page swapped out. */
+#define TRANSFER_BUFFER_SIZE (8 * 1024 * 1024)
+
 
 const char *g_target_dir = NULL;
 const char *g_file = NULL;
@@ -95,10 +104,19 @@ static int copy_file(const char *directory, const char *guest_file)
     }
 
     int fsize = 0;
-    char buf[1024 * 64] = { 0 };
+    char *buf = calloc(1, TRANSFER_BUFFER_SIZE);
+    if (!buf) {
+        fprintf(stderr, "Could not allocate memory for transfer buffer\n");
+        exit(1);
+    }
+
+#ifndef _WIN32
+    /* Not fatal: s2e_read touches the buffer before each transfer anyway */
+    mlock(buf, TRANSFER_BUFFER_SIZE);
+#endif
 
     while(1) {
-        int ret = s2e_read(s2e_fd, buf, sizeof(buf));
+        int ret = s2e_read(s2e_fd, buf, TRANSFER_BUFFER_SIZE);
         if(ret == -1) {
             fprintf(stderr, "s2e_read failed\n");
             exit(1);
@@ -120,6 +138,7 @@ static int copy_file(const char *directory, const char *guest_file)
 
     s2e_close(s2e_fd);
     close(fd);
+    free(buf);
     free(path);
 
     return 0;
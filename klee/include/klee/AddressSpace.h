@@ -13,7 +13,9 @@
 #include "ObjectHolder.h"
 
 #include "klee/Expr.h"
+#include "klee/Internal/ADT/ImmutableBTree.h"
 #include "klee/Internal/ADT/ImmutableMap.h"
+#include "klee/Internal/ADT/ImmutableRadixArray.h"
 
 #include "klee/BitfieldSimplifier.h"
 
@@ -23,6 +25,7 @@ namespace klee {
   class MemoryObject;
   class ObjectState;
   class TimingSolver;
+  class TimerStatIncrementer;
 
   template<class T> class ref;
 
@@ -34,7 +37,25 @@ namespace klee {
     bool operator()(const MemoryObject *a, const MemoryObject *b) const;
   };
   
-  typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT> MemoryMap;
+  typedef ImmutableMap<const MemoryObject*, ObjectHolder, MemoryObjectLT,
+                       ImmutableBTree> MemoryMap;
+
+  /// A range of memory split into fixed-size, aligned objects (e.g., guest
+  /// RAM). Their bindings are kept in a radix array indexed by
+  /// (address - base) >> objectBits instead of in the object map.
+  struct RamRegion {
+    uint64_t base;
+    uint64_t size;
+    unsigned objectBits;
+    ImmutableRadixArray<ObjectHolder> objects;
+
+    bool contains(uint64_t address) const {
+      return address - base < size;
+    }
+    size_t index(uint64_t address) const {
+      return (address - base) >> objectBits;
+    }
+  };
   
   class AddressSpace {
   private:
@@ -54,6 +75,10 @@ namespace klee {
     /// \invariant forall o in objects, o->copyOnWriteOwner <= cowKey
     MemoryMap objects;
 
+    /// Objects of the registered RAM regions, which are not in \a objects.
+    /// There are only a few regions, sorted by decreasing size.
+    std::vector<RamRegion> ramRegions;
+
     /// ExecutionState that owns this AddressSpace
     ExecutionState *state;
 
@@ -67,10 +92,34 @@ namespace klee {
                                       ObjectPair &result,
                                       bool *inBounds);
 
+  private:
+    /// Return the RAM region that stores the binding of \a mo, if any.
+    RamRegion *findRamRegion(const MemoryObject *mo);
+    const RamRegion *findRamRegion(const MemoryObject *mo) const;
+
+    /// Return the RAM region containing \a address, if any.
+    const RamRegion *findRamRegion(uint64_t address) const {
+      for (std::vector<RamRegion>::const_iterator it = ramRegions.begin(),
+           ie = ramRegions.end(); it != ie; ++it) {
+        if (it->contains(address))
+          return &*it;
+      }
+      return NULL;
+    }
+
+    /// Part of resolve() for an address whose example value lies in a
+    /// RAM object: scan that object and its neighbours in the region.
+    /// \return true iff resolve() must return \a incomplete right away.
+    bool resolveRam(ExecutionState &state, TimingSolver *solver,
+                    ref<Expr> p, uint64_t example, ResolutionList &rl,
+                    unsigned maxResolutions, uint64_t timeout_us,
+                    TimerStatIncrementer &timer, bool &incomplete);
+
   public:
     AddressSpace(ExecutionState* _state) : cowKey(1), state(_state) {}
     AddressSpace(const AddressSpace &b) :
-            cowKey(++b.cowKey), objects(b.objects), state(NULL) { }
+            cowKey(++b.cowKey), objects(b.objects),
+            ramRegions(b.ramRegions), state(NULL) { }
     ~AddressSpace() {}
 
     /// Resolve address to an ObjectPair in result.
@@ -108,6 +157,17 @@ namespace klee {
 
     /***/
 
+    /// Register [base, base+size) as a region of (1 << objectBits)-byte
+    /// objects. Objects of that size later bound at aligned addresses in
+    /// the region are looked up with a few loads instead of a map search.
+    void registerRamRegion(uint64_t base, uint64_t size, unsigned objectBits);
+
+    /// Append to \a result the bindings of RAM objects that differ in
+    /// \a b, as (ours, theirs) pairs. Shared parts are skipped cheaply.
+    void getChangedRamObjects(const AddressSpace &b,
+             std::vector<std::pair<const ObjectState*,
+                                   const ObjectState*> > &result) const;
+
     /// Add a binding to the address space.
     void bindObject(const MemoryObject *mo, ObjectState *os);
 
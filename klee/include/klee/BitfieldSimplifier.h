@@ -52,9 +52,15 @@ protected:
     };
     typedef std::pair<ref<Expr>, BitsInfo> ExprBitsInfo;
 
-    /// XXX: this cache will probably grow too large with time
+    /// Known bits of simplified expressions
     ExprHashMap<BitsInfo> m_bitsInfoCache;
 
+    /// Simplified form and known bits of expressions simplified with no
+    /// ignored bits, which is how every subexpression is first visited.
+    /// Both caches are flushed when they reach -expr-simplifier-cache-size
+    /// entries.
+    ExprHashMap<ExprBitsInfo> m_simplifiedCache;
+
     ref<Expr> replaceWithConstant(ref<Expr> e, uint64_t value);
 
     ExprBitsInfo doSimplifyBits(ref<Expr> e, uint64_t ignoredBits);
@@ -13,6 +13,8 @@
 #include "klee/Expr.h"
 #include <llvm/Support/raw_ostream.h>
 
+#include <map>
+
 // FIXME: Currently we use ConstraintManager for two things: to pass
 // sets of constraints around, and to optimize constraints. We should
 // move the first usage into a separate data structure
@@ -27,14 +29,16 @@ public:
   typedef constraints_ty::iterator iterator;
   typedef constraints_ty::const_iterator const_iterator;
 
-  ConstraintManager() {}
+  ConstraintManager() : indexed(true) {}
 
   // create from constraints with no optimization
   explicit
   ConstraintManager(const std::vector< ref<Expr> > &_constraints) :
-    constraints(_constraints) {}
+    constraints(_constraints), indexed(false) {}
 
-  ConstraintManager(const ConstraintManager &cs) : constraints(cs.constraints) {}
+  ConstraintManager(const ConstraintManager &cs)
+    : constraints(cs.constraints), implied(cs.implied),
+      equalities(cs.equalities), indexed(cs.indexed) {}
 
   typedef std::vector< ref<Expr> >::const_iterator constraint_iterator;
 
@@ -45,6 +49,12 @@ public:
   ref<Expr> simplifyExpr(ref<Expr> e) const;
 
   void addConstraint(ref<Expr> e);
+
+  /// Record that e is equal to value under the current constraints,
+  /// e.g. after the solver proved it. The equality is not added to the
+  /// constraints, simplifyExpr uses it to replace e. Adding constraints
+  /// cannot invalidate it.
+  void addImpliedEquality(ref<Expr> e, ref<ConstantExpr> value);
   
   bool empty() const {
     return constraints.empty();
@@ -76,6 +86,18 @@ public:
 private:
   std::vector< ref<Expr> > constraints;
 
+  /// Equalities recorded by addImpliedEquality
+  std::map< ref<Expr>, ref<Expr> > implied;
+
+  /// Substitutions applied by simplifyExpr: each constraint is replaced
+  /// by true, or for an equality with a constant the other side by the
+  /// constant, and each implied equality is applied. Built on the first
+  /// simplification, then updated as constraints are added.
+  mutable std::map< ref<Expr>, ref<Expr> > equalities;
+  mutable bool indexed;
+
+  void indexConstraint(const ref<Expr> &e) const;
+
   // returns true iff the constraints were modified
   bool rewriteConstraints(ExprVisitor &visitor);
 
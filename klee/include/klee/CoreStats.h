@@ -30,6 +30,22 @@ namespace stats {
   /// The number of process forks.
   extern Statistic forks;
 
+  /// Entries of the module constant table. The distinct values they share
+  /// are counted by Executor::getConstantPoolSize.
+  extern Statistic constants;
+
+  /// Expressions concretized for exceeding the size or depth budget
+  /// (see Executor::limitExprComplexity).
+  extern Statistic concretizedExprs;
+
+  /// Lookups of BitfieldSimplifier::simplify results for expressions
+  /// (and their subexpressions) simplified before.
+  extern Statistic simplifierCacheHits;
+  extern Statistic simplifierCacheMisses;
+
+  /// Calls to Executor::toUnique answered without querying the solver.
+  extern Statistic uniqueValueHits;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
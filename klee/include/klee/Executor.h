@@ -143,6 +143,12 @@ protected:
   /// globals that have no representative object (i.e. functions).
   std::map<const llvm::GlobalValue*, ref<ConstantExpr> > globalAddresses;
 
+  /// Values of the module constant table, shared by all the entries
+  /// that evaluate to the same value of up to 64 bits. Values that only
+  /// the pool refers to are evicted once it reaches constantPoolLimit.
+  std::map<std::pair<Expr::Width, uint64_t>, ref<ConstantExpr> > constantPool;
+  size_t constantPoolLimit;
+
   /// The set of legal function addresses, used to validate function
   /// pointers. We use the actual Function* address as the function address.
   std::set<uint64_t> legalFunctions;
@@ -352,6 +358,17 @@ protected:
   /// bindModuleConstants - Initialize the module constant table.
   void bindModuleConstants();
 
+  /// bindConstants - Evaluate the module constants added since the
+  /// table had begin entries.
+  void bindConstants(unsigned begin);
+
+  /// internConstant - Return the value of the constant pool equal to c.
+  ref<ConstantExpr> internConstant(const ref<ConstantExpr> &c);
+
+  /// purgeConstantPool - Drop the pool values that are not used anymore,
+  /// e.g., by the constant tables of deleted functions.
+  void purgeConstantPool();
+
   /// bindInstructionConstants - Initialize any necessary per instruction
   /// constant values.
   void bindInstructionConstants(KInstruction *KI);
@@ -443,8 +460,10 @@ public:
 
   /// Return a unique constant value for the given expression in the
   /// given state, if it has one (i.e. it provably only has a single
-  /// value). Otherwise return the original expression.
-  ref<Expr> toUnique(const ExecutionState &state, ref<Expr> &e);
+  /// value). Otherwise return the original expression. Proven values
+  /// are remembered in the constraints of the state, see
+  /// ConstraintManager::addImpliedEquality.
+  ref<Expr> toUnique(ExecutionState &state, ref<Expr> &e);
 
   /// Return a constant value for the given expression, forcing it to
   /// be constant in the given state but WITHOUT adding constraints.
@@ -460,6 +479,17 @@ public:
   ref<klee::ConstantExpr> toConstant(ExecutionState &state, ref<Expr> e,
                                      const char *purpose);
 
+  /// Return e, or its value in the given state (which is then added as
+  /// a constraint) if e has more than -max-expr-size distinct nodes or is deeper
+  /// than -max-expr-depth. Applied to stored values and branch
+  /// conditions so that a few huge expressions do not dominate the
+  /// solver time of the whole run.
+  ref<Expr> limitExprComplexity(ExecutionState &state, ref<Expr> e);
+
+  /// Called when limitExprComplexity concretizes e.
+  virtual void notifyExprConcretized(ExecutionState &state,
+                                     const ref<Expr> &e) {}
+
   virtual void setPathWriter(TreeStreamWriter *tsw) {
     pathWriter = tsw;
   }
@@ -525,6 +555,10 @@ public:
   virtual bool copyInConcretes(ExecutionState &state);
 
   size_t getStatesCount() const { return states.size(); }
+
+  /// Number of distinct values currently in the constant pool.
+  size_t getConstantPoolSize() const { return constantPool.size(); }
+
   const std::set<ExecutionState*> &getStates() {
     return states;
   }
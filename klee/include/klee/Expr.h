@@ -169,10 +169,15 @@ public:
 
 protected:  
   unsigned hashValue;
+
+  /// Number of nodes of the expression seen as a tree (saturated), an
+  /// upper bound of its DAG size, and the length of its longest path.
+  unsigned treeSize;
+  unsigned depth;
   
 public:
-  Expr() : refCount(0) { Expr::count++; }
-  virtual ~Expr() { Expr::count--; } 
+  Expr() : refCount(0), treeSize(1), depth(0) { refInc(Expr::count); }
+  virtual ~Expr() { refDec(Expr::count); }
 
   virtual Kind getKind() const = 0;
   virtual Width getWidth() const = 0;
@@ -191,6 +196,19 @@ public:
   /// (Re)computes the hash of the current expression.
   /// Returns the hash value. 
   virtual unsigned computeHash();
+
+  /// Computes treeSize and depth from the kids. Reads also count the
+  /// updates of their array. Called when allocating non-constant
+  /// expressions.
+  void computeComplexity();
+
+  unsigned getTreeSize() const { return treeSize; }
+  unsigned getDepth() const { return depth; }
+
+  /// Number of distinct nodes of the expression DAG, counting each
+  /// update node of a read once. Never more than getTreeSize(). If limit
+  /// is not 0, stops counting once the size exceeds limit.
+  unsigned computeDagSize(unsigned limit = 0) const;
   
   /// Returns 0 iff b is structuraly equivalent to *this
   int compare(const Expr &b) const;
@@ -523,6 +541,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &src) {
     ref<Expr> r(new NotOptimizedExpr(src));
     r->computeHash();
+    r->computeComplexity();
     return r;
   }
   
@@ -669,6 +688,7 @@ public:
   static ref<Expr> alloc(const UpdateList &updates, const ref<Expr> &index) {
     ref<Expr> r(new ReadExpr(updates, index));
     r->computeHash();
+    r->computeComplexity();
     return r;
   }
   
@@ -714,6 +734,7 @@ public:
                          const ref<Expr> &f) {
     ref<Expr> r(new SelectExpr(c, t, f));
     r->computeHash();
+    r->computeComplexity();
     return r;
   }
   
@@ -771,6 +792,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) {
     ref<Expr> c(new ConcatExpr(l, r));
     c->computeHash();
+    c->computeComplexity();
     return c;
   }
   
@@ -830,6 +852,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e, unsigned o, Width w) {
     ref<Expr> r(new ExtractExpr(e, o, w));
     r->computeHash();
+    r->computeComplexity();
     return r;
   }
   
@@ -881,6 +904,7 @@ public:
   static ref<Expr> alloc(const ref<Expr> &e) {
     ref<Expr> r(new NotExpr(e));
     r->computeHash();
+    r->computeComplexity();
     return r;
   }
   
@@ -958,6 +982,7 @@ public:                                                          \
     static ref<Expr> alloc(const ref<Expr> &e, Width w) {        \
       ref<Expr> r(new _class_kind ## Expr(e, w));                \
       r->computeHash();                                          \
+      r->computeComplexity();                                    \
       return r;                                                  \
     }                                                            \
     static ref<Expr> create(const ref<Expr> &e, Width w);        \
@@ -990,6 +1015,7 @@ public:                                                              \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
+      res->computeComplexity();                                      \
       return res;                                                    \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
@@ -1034,6 +1060,7 @@ public:                                                              \
     static ref<Expr> alloc(const ref<Expr> &l, const ref<Expr> &r) { \
       ref<Expr> res(new _class_kind ## Expr (l, r));                 \
       res->computeHash();                                            \
+      res->computeComplexity();                                      \
       return res;                                                    \
     }                                                                \
     static ref<Expr> create(const ref<Expr> &l, const ref<Expr> &r); \
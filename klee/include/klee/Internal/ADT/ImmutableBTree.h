@@ -0,0 +1,735 @@
+//===-- ImmutableBTree.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __UTIL_IMMUTABLEBTREE_H__
+#define __UTIL_IMMUTABLEBTREE_H__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+
+namespace klee {
+  /// ImmutableBTree - A persistent B+-tree with the same interface as
+  /// ImmutableTree. Values live in leaves of up to Order entries and inner
+  /// nodes cache the smallest key of each child, so a lookup walks
+  /// log_{Order}(n) contiguous nodes. An update copies the nodes on one
+  /// root-to-leaf path and shares everything else, which keeps copies of
+  /// the tree (e.g., forked address spaces) as cheap as a reference bump.
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableBTree {
+  public:
+    static size_t allocated;
+    class iterator;
+
+    typedef K key_type;
+    typedef V value_type;
+    typedef KOV key_of_value;
+    typedef CMP key_compare;
+
+    enum {
+      Order = 16,             // maximum number of entries per node
+      MinFill = Order / 2,    // minimum number of entries per non-root node
+      MaxHeight = 16          // enough for MinFill^(MaxHeight-1) values
+    };
+
+  public:
+    ImmutableBTree();
+    ImmutableBTree(const ImmutableBTree &s);
+    ~ImmutableBTree();
+
+    ImmutableBTree &operator=(const ImmutableBTree &s);
+
+    bool empty() const;
+
+    size_t count(const key_type &key) const; // always 0 or 1
+    const value_type *lookup(const key_type &key) const;
+
+    // find the last value less than or equal to key, or null if
+    // no such value exists
+    const value_type *lookup_previous(const key_type &key) const;
+
+    const value_type &min() const;
+    const value_type &max() const;
+    size_t size() const;
+
+    ImmutableBTree insert(const value_type &value) const;
+    ImmutableBTree replace(const value_type &value) const;
+    ImmutableBTree remove(const key_type &key) const;
+    ImmutableBTree popMin(value_type &valueOut) const;
+    ImmutableBTree popMax(value_type &valueOut) const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const key_type &key) const;
+    iterator lower_bound(const key_type &key) const;
+    iterator upper_bound(const key_type &key) const;
+
+    static size_t getAllocated() { return allocated; }
+
+  private:
+    class Node;
+    class Leaf;
+    class Inner;
+
+    Node *root; // null for the empty tree
+    size_t elements;
+
+    ImmutableBTree(Node *_root, size_t _elements);
+
+    ImmutableBTree insertOrReplace(const value_type &value,
+                                   bool replace) const;
+    iterator bound(const key_type &key, bool upper) const;
+
+    static Node *insert(Node *n, const value_type &v, bool replace,
+                        Node *&split, bool &added);
+    static Node *insertEntry(Inner *n, unsigned pos, Node *child,
+                             Node *&split);
+    static Node *remove(Node *n, const key_type &k, bool &removed);
+    static void rebalance(Inner *n, unsigned pos);
+  };
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableBTree<K,V,KOV,CMP>::Node {
+  public:
+    unsigned references;
+    unsigned short count;
+    bool leaf;
+
+    Node(bool _leaf) : references(1), count(0), leaf(_leaf) {
+      ++allocated;
+    }
+    ~Node() {
+      --allocated;
+    }
+
+    Node *incref() {
+      ++references;
+      return this;
+    }
+    void decref();
+
+    const key_type &minKey() const;
+  };
+
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableBTree<K,V,KOV,CMP>::Leaf : public Node {
+  public:
+    value_type values[Order];
+
+    Leaf() : Node(true) {}
+
+    // index of the first value not less than k
+    unsigned lowerBound(const key_type &k) const {
+      unsigned i = 0;
+      while (i < this->count && key_compare()(key_of_value()(values[i]), k))
+        ++i;
+      return i;
+    }
+    // index of the first value greater than k
+    unsigned upperBound(const key_type &k) const {
+      unsigned i = 0;
+      while (i < this->count && !key_compare()(k, key_of_value()(values[i])))
+        ++i;
+      return i;
+    }
+  };
+
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableBTree<K,V,KOV,CMP>::Inner : public Node {
+  public:
+    key_type keys[Order]; // keys[i] is the smallest key below children[i]
+    Node *children[Order];
+
+    Inner() : Node(false) {}
+    ~Inner() {
+      for (unsigned i = 0; i < this->count; ++i)
+        children[i]->decref();
+    }
+
+    // index of the child that may contain k
+    unsigned childFor(const key_type &k) const {
+      unsigned i = 1;
+      while (i < this->count && !key_compare()(k, keys[i]))
+        ++i;
+      return i - 1;
+    }
+
+    void set(unsigned i, Node *child) {
+      keys[i] = child->minKey();
+      children[i] = child;
+    }
+
+    Inner *copy() const {
+      Inner *res = new Inner();
+      for (unsigned i = 0; i < this->count; ++i) {
+        res->keys[i] = keys[i];
+        res->children[i] = children[i]->incref();
+      }
+      res->count = this->count;
+      return res;
+    }
+  };
+
+  template<class K, class V, class KOV, class CMP>
+  void ImmutableBTree<K,V,KOV,CMP>::Node::decref() {
+    if (--references)
+      return;
+    if (leaf)
+      delete static_cast<Leaf*>(this);
+    else
+      delete static_cast<Inner*>(this);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  const typename ImmutableBTree<K,V,KOV,CMP>::key_type &
+  ImmutableBTree<K,V,KOV,CMP>::Node::minKey() const {
+    assert(count && "empty node has no key");
+    if (leaf)
+      return key_of_value()(static_cast<const Leaf*>(this)->values[0]);
+    return static_cast<const Inner*>(this)->keys[0];
+  }
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP>
+  class ImmutableBTree<K,V,KOV,CMP>::iterator {
+    friend class ImmutableBTree<K,V,KOV,CMP>;
+  private:
+    Node *root; // so can back up from end
+    Node *nodes[MaxHeight];
+    unsigned indices[MaxHeight];
+    unsigned depth; // zero at end
+
+    iterator(Node *_root) : root(_root), depth(0) {
+      if (root)
+        root->incref();
+    }
+
+    void push(Node *n, unsigned index) {
+      assert(depth < MaxHeight && "tree too deep");
+      nodes[depth] = n;
+      indices[depth] = index;
+      ++depth;
+    }
+
+    void descendLeftmost(Node *n) {
+      for (;;) {
+        push(n, 0);
+        if (n->leaf)
+          break;
+        n = static_cast<Inner*>(n)->children[0];
+      }
+    }
+
+    void descendRightmost(Node *n) {
+      for (;;) {
+        push(n, n->count - 1);
+        if (n->leaf)
+          break;
+        n = static_cast<Inner*>(n)->children[n->count - 1];
+      }
+    }
+
+    const value_type &value() const {
+      assert(depth && "dereferencing end iterator");
+      return static_cast<Leaf*>(nodes[depth-1])->values[indices[depth-1]];
+    }
+
+  public:
+    iterator(const iterator &i) : root(i.root), depth(i.depth) {
+      if (root)
+        root->incref();
+      std::copy(i.nodes, i.nodes + depth, nodes);
+      std::copy(i.indices, i.indices + depth, indices);
+    }
+    ~iterator() {
+      if (root)
+        root->decref();
+    }
+
+    iterator &operator=(const iterator &b) {
+      if (b.root)
+        b.root->incref();
+      if (root)
+        root->decref();
+      root = b.root;
+      depth = b.depth;
+      std::copy(b.nodes, b.nodes + depth, nodes);
+      std::copy(b.indices, b.indices + depth, indices);
+      return *this;
+    }
+
+    const value_type &operator*() {
+      return value();
+    }
+
+    const value_type *operator->() {
+      return &value();
+    }
+
+    // The leaf and the slot in it identify a position uniquely.
+    bool operator==(const iterator &b) {
+      if (depth != b.depth)
+        return false;
+      return !depth || (nodes[depth-1] == b.nodes[depth-1] &&
+                        indices[depth-1] == b.indices[depth-1]);
+    }
+    bool operator!=(const iterator &b) {
+      return !(*this == b);
+    }
+
+    iterator &operator--() {
+      if (!depth) {
+        if (root)
+          descendRightmost(root);
+        return *this;
+      }
+      while (depth && !indices[depth-1])
+        --depth;
+      if (depth) {
+        unsigned i = --indices[depth-1];
+        Node *n = nodes[depth-1];
+        if (!n->leaf)
+          descendRightmost(static_cast<Inner*>(n)->children[i]);
+      }
+      return *this;
+    }
+
+    iterator &operator++() {
+      assert(depth && "incrementing end iterator");
+      while (depth && indices[depth-1] + 1 == nodes[depth-1]->count)
+        --depth;
+      if (depth) {
+        unsigned i = ++indices[depth-1];
+        Node *n = nodes[depth-1];
+        if (!n->leaf)
+          descendLeftmost(static_cast<Inner*>(n)->children[i]);
+      }
+      return *this;
+    }
+  };
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP>
+  size_t ImmutableBTree<K,V,KOV,CMP>::allocated = 0;
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::Node *
+  ImmutableBTree<K,V,KOV,CMP>::insert(Node *n, const value_type &v,
+                                      bool replace, Node *&split,
+                                      bool &added) {
+    const key_type &k = key_of_value()(v);
+
+    if (n->leaf) {
+      Leaf *l = static_cast<Leaf*>(n);
+      unsigned pos = l->lowerBound(k);
+      if (pos < l->count && !key_compare()(k, key_of_value()(l->values[pos]))) {
+        if (!replace)
+          return n->incref();
+        Leaf *res = new Leaf();
+        std::copy(l->values, l->values + l->count, res->values);
+        res->count = l->count;
+        res->values[pos] = v;
+        return res;
+      }
+
+      added = true;
+      unsigned total = l->count + 1;
+      Leaf *left = new Leaf(), *right = 0;
+      unsigned half = total;
+      if (total > Order) {
+        right = new Leaf();
+        half = total / 2;
+      }
+      for (unsigned i = 0; i < total; ++i) {
+        const value_type &x = i < pos ? l->values[i] :
+                              i == pos ? v : l->values[i-1];
+        Leaf *dst = i < half ? left : right;
+        dst->values[dst->count++] = x;
+      }
+      split = right;
+      return left;
+    }
+
+    Inner *in = static_cast<Inner*>(n);
+    unsigned idx = in->childFor(k);
+    Node *childSplit = 0;
+    Node *child = insert(in->children[idx], v, replace, childSplit, added);
+    if (child == in->children[idx]) {
+      child->decref();
+      return n->incref();
+    }
+
+    Inner *res = in->copy();
+    res->children[idx]->decref();
+    res->set(idx, child);
+    if (!childSplit)
+      return res;
+    return insertEntry(res, idx + 1, childSplit, split);
+  }
+
+  // Insert child at pos in the fresh node n, splitting it if it overflows.
+  // Takes ownership of n and child.
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::Node *
+  ImmutableBTree<K,V,KOV,CMP>::insertEntry(Inner *n, unsigned pos,
+                                           Node *child, Node *&split) {
+    if (n->count < Order) {
+      for (unsigned i = n->count; i > pos; --i) {
+        n->keys[i] = n->keys[i-1];
+        n->children[i] = n->children[i-1];
+      }
+      n->set(pos, child);
+      ++n->count;
+      return n;
+    }
+
+    unsigned total = n->count + 1, half = total / 2;
+    Inner *left = new Inner(), *right = new Inner();
+    for (unsigned i = 0; i < total; ++i) {
+      Node *c = i < pos ? n->children[i] :
+                i == pos ? child : n->children[i-1];
+      Inner *dst = i < half ? left : right;
+      dst->set(dst->count++, c);
+    }
+    n->count = 0; // children now belong to left and right
+    n->decref();
+    split = right;
+    return left;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::Node *
+  ImmutableBTree<K,V,KOV,CMP>::remove(Node *n, const key_type &k,
+                                      bool &removed) {
+    if (n->leaf) {
+      Leaf *l = static_cast<Leaf*>(n);
+      unsigned pos = l->lowerBound(k);
+      if (pos == l->count || key_compare()(k, key_of_value()(l->values[pos])))
+        return n->incref();
+
+      removed = true;
+      Leaf *res = new Leaf();
+      std::copy(l->values, l->values + pos, res->values);
+      std::copy(l->values + pos + 1, l->values + l->count, res->values + pos);
+      res->count = l->count - 1;
+      return res;
+    }
+
+    Inner *in = static_cast<Inner*>(n);
+    unsigned idx = in->childFor(k);
+    Node *child = remove(in->children[idx], k, removed);
+    if (child == in->children[idx]) {
+      child->decref();
+      return n->incref();
+    }
+
+    Inner *res = in->copy();
+    res->children[idx]->decref();
+    res->children[idx] = child;
+    if (child->count < MinFill && res->count > 1) {
+      rebalance(res, idx);
+    } else {
+      res->keys[idx] = child->minKey();
+    }
+    return res;
+  }
+
+  // Merge the underfull child at pos with a neighbour, or redistribute
+  // their entries evenly if they do not fit in a single node.
+  template<class K, class V, class KOV, class CMP>
+  void ImmutableBTree<K,V,KOV,CMP>::rebalance(Inner *n, unsigned pos) {
+    unsigned li = pos ? pos - 1 : pos, ri = li + 1;
+    Node *a = n->children[li], *b = n->children[ri];
+    unsigned total = a->count + b->count;
+    unsigned half = total <= Order ? total : total / 2;
+    Node *m1, *m2 = 0;
+
+    if (a->leaf) {
+      Leaf *la = static_cast<Leaf*>(a), *lb = static_cast<Leaf*>(b);
+      Leaf *r1 = new Leaf(), *r2 = total > half ? new Leaf() : 0;
+      for (unsigned i = 0; i < total; ++i) {
+        const value_type &x = i < la->count ? la->values[i] :
+                              lb->values[i - la->count];
+        Leaf *dst = i < half ? r1 : r2;
+        dst->values[dst->count++] = x;
+      }
+      m1 = r1;
+      m2 = r2;
+    } else {
+      Inner *ia = static_cast<Inner*>(a), *ib = static_cast<Inner*>(b);
+      Inner *r1 = new Inner(), *r2 = total > half ? new Inner() : 0;
+      for (unsigned i = 0; i < total; ++i) {
+        Node *c = i < ia->count ? ia->children[i] :
+                  ib->children[i - ia->count];
+        Inner *dst = i < half ? r1 : r2;
+        dst->set(dst->count++, c->incref());
+      }
+      m1 = r1;
+      m2 = r2;
+    }
+
+    a->decref();
+    b->decref();
+    n->set(li, m1);
+    if (m2) {
+      n->set(ri, m2);
+    } else {
+      for (unsigned i = ri + 1; i < n->count; ++i) {
+        n->keys[i-1] = n->keys[i];
+        n->children[i-1] = n->children[i];
+      }
+      --n->count;
+    }
+  }
+
+  /***/
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>::ImmutableBTree()
+    : root(0), elements(0) {
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>::ImmutableBTree(Node *_root, size_t _elements)
+    : root(_root), elements(_elements) {
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>::ImmutableBTree(const ImmutableBTree &s)
+    : root(s.root), elements(s.elements) {
+    if (root)
+      root->incref();
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>::~ImmutableBTree() {
+    if (root)
+      root->decref();
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP> &
+  ImmutableBTree<K,V,KOV,CMP>::operator=(const ImmutableBTree &s) {
+    if (s.root)
+      s.root->incref();
+    if (root)
+      root->decref();
+    root = s.root;
+    elements = s.elements;
+    return *this;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  bool ImmutableBTree<K,V,KOV,CMP>::empty() const {
+    return !root;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  size_t ImmutableBTree<K,V,KOV,CMP>::count(const key_type &k) const {
+    return lookup(k) ? 1 : 0;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  const typename ImmutableBTree<K,V,KOV,CMP>::value_type *
+  ImmutableBTree<K,V,KOV,CMP>::lookup(const key_type &k) const {
+    if (!root)
+      return 0;
+    Node *n = root;
+    while (!n->leaf) {
+      Inner *in = static_cast<Inner*>(n);
+      n = in->children[in->childFor(k)];
+    }
+    Leaf *l = static_cast<Leaf*>(n);
+    unsigned pos = l->lowerBound(k);
+    if (pos == l->count || key_compare()(k, key_of_value()(l->values[pos])))
+      return 0;
+    return &l->values[pos];
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  const typename ImmutableBTree<K,V,KOV,CMP>::value_type *
+  ImmutableBTree<K,V,KOV,CMP>::lookup_previous(const key_type &k) const {
+    if (!root || key_compare()(k, root->minKey()))
+      return 0;
+    Node *n = root;
+    while (!n->leaf) {
+      Inner *in = static_cast<Inner*>(n);
+      n = in->children[in->childFor(k)];
+    }
+    Leaf *l = static_cast<Leaf*>(n);
+    return &l->values[l->upperBound(k) - 1];
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  const typename ImmutableBTree<K,V,KOV,CMP>::value_type &
+  ImmutableBTree<K,V,KOV,CMP>::min() const {
+    assert(root && "min() on empty tree");
+    Node *n = root;
+    while (!n->leaf)
+      n = static_cast<Inner*>(n)->children[0];
+    return static_cast<Leaf*>(n)->values[0];
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  const typename ImmutableBTree<K,V,KOV,CMP>::value_type &
+  ImmutableBTree<K,V,KOV,CMP>::max() const {
+    assert(root && "max() on empty tree");
+    Node *n = root;
+    while (!n->leaf)
+      n = static_cast<Inner*>(n)->children[n->count - 1];
+    return static_cast<Leaf*>(n)->values[n->count - 1];
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  size_t ImmutableBTree<K,V,KOV,CMP>::size() const {
+    return elements;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>
+  ImmutableBTree<K,V,KOV,CMP>::insertOrReplace(const value_type &value,
+                                               bool replace) const {
+    if (!root) {
+      Leaf *l = new Leaf();
+      l->values[0] = value;
+      l->count = 1;
+      return ImmutableBTree(l, 1);
+    }
+
+    Node *split = 0;
+    bool added = false;
+    Node *n = insert(root, value, replace, split, added);
+    if (split) {
+      Inner *in = new Inner();
+      in->set(0, n);
+      in->set(1, split);
+      in->count = 2;
+      n = in;
+    }
+    return ImmutableBTree(n, elements + (added ? 1 : 0));
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>
+  ImmutableBTree<K,V,KOV,CMP>::insert(const value_type &value) const {
+    return insertOrReplace(value, false);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>
+  ImmutableBTree<K,V,KOV,CMP>::replace(const value_type &value) const {
+    return insertOrReplace(value, true);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>
+  ImmutableBTree<K,V,KOV,CMP>::remove(const key_type &key) const {
+    if (!root)
+      return *this;
+
+    bool removed = false;
+    Node *n = remove(root, key, removed);
+    if (!removed)
+      return ImmutableBTree(n, elements);
+
+    // Shrink the tree while the root has a single child.
+    while (!n->leaf && n->count == 1) {
+      Node *child = static_cast<Inner*>(n)->children[0]->incref();
+      n->decref();
+      n = child;
+    }
+    if (!n->count) {
+      n->decref();
+      n = 0;
+    }
+    return ImmutableBTree(n, elements - 1);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>
+  ImmutableBTree<K,V,KOV,CMP>::popMin(value_type &valueOut) const {
+    valueOut = min();
+    return remove(key_of_value()(valueOut));
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  ImmutableBTree<K,V,KOV,CMP>
+  ImmutableBTree<K,V,KOV,CMP>::popMax(value_type &valueOut) const {
+    valueOut = max();
+    return remove(key_of_value()(valueOut));
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::iterator
+  ImmutableBTree<K,V,KOV,CMP>::begin() const {
+    iterator it(root);
+    if (root)
+      it.descendLeftmost(root);
+    return it;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::iterator
+  ImmutableBTree<K,V,KOV,CMP>::end() const {
+    return iterator(root);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::iterator
+  ImmutableBTree<K,V,KOV,CMP>::bound(const key_type &k, bool upper) const {
+    iterator it(root);
+    if (!root)
+      return it;
+
+    Node *n = root;
+    while (!n->leaf) {
+      Inner *in = static_cast<Inner*>(n);
+      unsigned i = in->childFor(k);
+      it.push(n, i);
+      n = in->children[i];
+    }
+    Leaf *l = static_cast<Leaf*>(n);
+    unsigned pos = upper ? l->upperBound(k) : l->lowerBound(k);
+    if (pos < l->count) {
+      it.push(n, pos);
+    } else {
+      // The bound is the first value of the next leaf, if any.
+      it.push(n, pos - 1);
+      ++it;
+    }
+    return it;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::iterator
+  ImmutableBTree<K,V,KOV,CMP>::find(const key_type &k) const {
+    iterator it = bound(k, false);
+    if (it != end() && key_compare()(k, key_of_value()(*it)))
+      return end();
+    return it;
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::iterator
+  ImmutableBTree<K,V,KOV,CMP>::lower_bound(const key_type &k) const {
+    return bound(k, false);
+  }
+
+  template<class K, class V, class KOV, class CMP>
+  typename ImmutableBTree<K,V,KOV,CMP>::iterator
+  ImmutableBTree<K,V,KOV,CMP>::upper_bound(const key_type &k) const {
+    return bound(k, true);
+  }
+}
+
+#endif
@@ -21,13 +21,16 @@ namespace klee {
     const D &operator()(const V &a) const { return a.first; }
   };
   
-  template<class K, class D, class CMP=std::less<K> >
+  /// ImmutableMap - A persistent map. TREE selects the underlying
+  /// persistent tree, either ImmutableTree or ImmutableBTree.
+  template<class K, class D, class CMP=std::less<K>,
+           template<class, class, class, class> class TREE=ImmutableTree>
   class ImmutableMap {
   public:
     typedef K key_type;
     typedef std::pair<K,D> value_type;
 
-    typedef ImmutableTree<K, value_type, _Select1st<value_type,key_type>, CMP> Tree;
+    typedef TREE<K, value_type, _Select1st<value_type,key_type>, CMP> Tree;
     typedef typename Tree::iterator iterator;
 
   private:
@@ -73,10 +76,10 @@ namespace klee {
     ImmutableMap remove(const key_type &key) const { 
       return elts.remove(key); 
     }
-    ImmutableMap popMin(const value_type &valueOut) const { 
+    ImmutableMap popMin(value_type &valueOut) const { 
       return elts.popMin(valueOut); 
     }
-    ImmutableMap popMax(const value_type &valueOut) const { 
+    ImmutableMap popMax(value_type &valueOut) const { 
       return elts.popMax(valueOut); 
     }
 
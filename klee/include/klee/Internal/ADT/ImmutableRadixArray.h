@@ -0,0 +1,215 @@
+//===-- ImmutableRadixArray.h -----------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef __UTIL_IMMUTABLERADIXARRAY_H__
+#define __UTIL_IMMUTABLERADIXARRAY_H__
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace klee {
+  /// ImmutableRadixArray - A fixed-size array shared between copies as a
+  /// radix tree of reference counted nodes. An element is found with one
+  /// load per level.
+  ///
+  /// Copying the array only bumps the root reference count. An update
+  /// modifies in place the nodes on its path that are referenced once and
+  /// copies the first shared one along with everything below it, so the
+  /// first write to a region after a copy costs one path and later writes
+  /// to the same region cost none.
+  template<class T, unsigned FANOUT_BITS=6>
+  class ImmutableRadixArray {
+  public:
+    static size_t allocated;
+
+    enum { Fanout = 1 << FANOUT_BITS };
+
+  private:
+    struct Node {
+      unsigned references;
+
+      Node() : references(1) { ++allocated; }
+      ~Node() { --allocated; }
+    };
+
+    struct Inner : Node {
+      Node *children[Fanout];
+
+      Inner() {
+        for (unsigned i = 0; i < Fanout; ++i)
+          children[i] = 0;
+      }
+    };
+
+    struct Leaf : Node {
+      T values[Fanout];
+
+      Leaf() {}
+    };
+
+    Node *root;
+    size_t elements;
+    unsigned levels; // number of inner levels above the leaves
+
+    static const T &empty() {
+      static T value;
+      return value;
+    }
+
+    static unsigned slot(size_t index, unsigned level) {
+      return (index >> (FANOUT_BITS * (level + 1))) & (Fanout - 1);
+    }
+
+    static void decref(Node *n, unsigned level);
+    static Node *copy(Node *n, unsigned level);
+    static void diff(Node *a, Node *b, unsigned level, size_t base,
+                     std::vector<size_t> &result);
+
+  public:
+    ImmutableRadixArray() : root(0), elements(0), levels(0) {}
+    explicit ImmutableRadixArray(size_t size) : root(0), elements(size),
+                                                levels(0) {
+      while (((size_t) Fanout << (FANOUT_BITS * levels)) < size)
+        ++levels;
+    }
+    ImmutableRadixArray(const ImmutableRadixArray &b)
+      : root(b.root), elements(b.elements), levels(b.levels) {
+      if (root)
+        ++root->references;
+    }
+    ~ImmutableRadixArray() {
+      if (root)
+        decref(root, levels);
+    }
+
+    ImmutableRadixArray &operator=(const ImmutableRadixArray &b) {
+      if (b.root)
+        ++b.root->references;
+      if (root)
+        decref(root, levels);
+      root = b.root;
+      elements = b.elements;
+      levels = b.levels;
+      return *this;
+    }
+
+    size_t size() const { return elements; }
+
+    /// Return the element at index, or a default constructed T if it was
+    /// never set.
+    const T &get(size_t index) const {
+      assert(index < elements && "index out of bounds");
+      Node *n = root;
+      for (unsigned level = levels; n && level; --level)
+        n = static_cast<Inner*>(n)->children[slot(index, level - 1)];
+      return n ? static_cast<Leaf*>(n)->values[index & (Fanout - 1)]
+               : empty();
+    }
+
+    /// Store value at index, copying the shared nodes on its path.
+    void set(size_t index, const T &value);
+
+    /// Append to result the indices whose elements differ from those in
+    /// b, which must have the same size. Subtrees shared by both arrays
+    /// are skipped without being visited.
+    void diff(const ImmutableRadixArray &b, std::vector<size_t> &result) const {
+      assert(elements == b.elements && "arrays of different sizes");
+      diff(root, b.root, levels, 0, result);
+    }
+
+    static size_t getAllocated() { return allocated; }
+  };
+
+  /***/
+
+  template<class T, unsigned FANOUT_BITS>
+  size_t ImmutableRadixArray<T,FANOUT_BITS>::allocated = 0;
+
+  template<class T, unsigned FANOUT_BITS>
+  void ImmutableRadixArray<T,FANOUT_BITS>::decref(Node *n, unsigned level) {
+    if (--n->references)
+      return;
+    if (!level) {
+      delete static_cast<Leaf*>(n);
+      return;
+    }
+    Inner *in = static_cast<Inner*>(n);
+    for (unsigned i = 0; i < Fanout; ++i)
+      if (in->children[i])
+        decref(in->children[i], level - 1);
+    delete in;
+  }
+
+  template<class T, unsigned FANOUT_BITS>
+  typename ImmutableRadixArray<T,FANOUT_BITS>::Node *
+  ImmutableRadixArray<T,FANOUT_BITS>::copy(Node *n, unsigned level) {
+    if (!level) {
+      Leaf *res = new Leaf();
+      if (n)
+        std::copy(static_cast<Leaf*>(n)->values,
+                  static_cast<Leaf*>(n)->values + Fanout, res->values);
+      return res;
+    }
+    Inner *res = new Inner();
+    if (n) {
+      Inner *in = static_cast<Inner*>(n);
+      for (unsigned i = 0; i < Fanout; ++i)
+        if ((res->children[i] = in->children[i]))
+          ++res->children[i]->references;
+    }
+    return res;
+  }
+
+  template<class T, unsigned FANOUT_BITS>
+  void ImmutableRadixArray<T,FANOUT_BITS>::set(size_t index, const T &value) {
+    assert(index < elements && "index out of bounds");
+    Node **p = &root;
+    for (unsigned level = levels; ; --level) {
+      Node *n = *p;
+      if (!n || n->references > 1) {
+        Node *c = copy(n, level);
+        if (n)
+          decref(n, level);
+        *p = n = c;
+      }
+      if (!level) {
+        static_cast<Leaf*>(n)->values[index & (Fanout - 1)] = value;
+        return;
+      }
+      p = &static_cast<Inner*>(n)->children[slot(index, level - 1)];
+    }
+  }
+
+  template<class T, unsigned FANOUT_BITS>
+  void ImmutableRadixArray<T,FANOUT_BITS>::diff(Node *a, Node *b,
+                                                unsigned level, size_t base,
+                                                std::vector<size_t> &result) {
+    if (a == b)
+      return;
+    if (!level) {
+      for (unsigned i = 0; i < Fanout; ++i) {
+        const T &va = a ? static_cast<Leaf*>(a)->values[i] : empty();
+        const T &vb = b ? static_cast<Leaf*>(b)->values[i] : empty();
+        if (!(va == vb))
+          result.push_back(base + i);
+      }
+      return;
+    }
+    size_t stride = (size_t) 1 << (FANOUT_BITS * level);
+    for (unsigned i = 0; i < Fanout; ++i) {
+      Node *ca = a ? static_cast<Inner*>(a)->children[i] : 0;
+      Node *cb = b ? static_cast<Inner*>(b)->children[i] : 0;
+      diff(ca, cb, level - 1, base + i * stride, result);
+    }
+  }
+}
+
+#endif
@@ -52,6 +52,7 @@ namespace klee {
     InstructionInfo dummyInfo;
     std::map<const llvm::Instruction*, InstructionInfo> infos;
     std::set<const std::string *, ltstr> internedStrings;
+    unsigned maxID;
 
   private:
     const std::string *internString(std::string s);
@@ -65,6 +66,10 @@ namespace klee {
     unsigned getMaxID() const;
     const InstructionInfo &getInfo(const llvm::Instruction*) const;
     const InstructionInfo &getFunctionInfo(const llvm::Function*) const;
+
+    /// Drop the entries of all instructions of the given function.
+    /// Must be called before the function is erased from its module.
+    void removeFunction(const llvm::Function *f);
   };
 
 }
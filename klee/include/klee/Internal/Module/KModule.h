@@ -109,6 +109,12 @@ namespace klee {
   protected:
     KModulePrivate *p;
 
+    void transform(const Interpreter::ModuleOptions &opts);
+
+    std::string getCacheFileName(const Interpreter::ModuleOptions &opts);
+    bool loadCachedModule(const std::string &fileName);
+    void saveCachedModule(const std::string &fileName);
+
   public:
     KModule(llvm::Module *_module);
     ~KModule();
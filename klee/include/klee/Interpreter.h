@@ -54,11 +54,16 @@ public:
     bool CheckDivZero;
     llvm::FunctionPassManager *CustomPasses;
 
+    /// Identifies the CustomPasses in the key of cached modules.
+    std::string CacheTag;
+
     ModuleOptions(const std::vector<std::string>& _ExtraLibraries,
                   bool _Optimize, bool _CheckDivZero,
-                  llvm::FunctionPassManager *_CustomPasses = NULL)
+                  llvm::FunctionPassManager *_CustomPasses = NULL,
+                  const std::string &_CacheTag = "")
       : ExtraLibraries(_ExtraLibraries),
-        Optimize(_Optimize), CheckDivZero(_CheckDivZero), CustomPasses(_CustomPasses) {}
+        Optimize(_Optimize), CheckDivZero(_CheckDivZero), CustomPasses(_CustomPasses),
+        CacheTag(_CacheTag) {}
   };
 
   /// InterpreterOptions - Options varying the runtime behavior during
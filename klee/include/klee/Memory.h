@@ -178,6 +178,17 @@ private:
   // mutable because we may need flush during read of const
   mutable UpdateList updates;
 
+  /// Identifies the current contents of concreteMask. It changes whenever
+  /// a byte switches between concrete and symbolic and is kept by copies,
+  /// so equal stamps imply equal masks, even across objects.
+  uint64_t concreteMaskStamp;
+  static uint64_t lastConcreteMaskStamp;
+
+  /// Stamps are global, and states may be created concurrently.
+  static uint64_t nextConcreteMaskStamp() {
+    return __sync_add_and_fetch(&lastConcreteMaskStamp, 1);
+  }
+
 public:
   unsigned size;
 
@@ -220,6 +231,18 @@ public:
     }
   }
 
+  // fast-path to get a range of concrete values, fails if any byte
+  // of the range is symbolic
+  bool readConcrete(unsigned offset, uint8_t *buf, unsigned count) const {
+    if(object->isSharedConcrete) {
+      memcpy(buf, ((uint8_t*) object->address) + offset, count); return true;
+    } else if(!concreteMask || concreteMask->isAllOnes(offset, count)) {
+      memcpy(buf, concreteStore + offset, count); return true;
+    } else {
+      return false;
+    }
+  }
+
   // return bytes written.
   void write(unsigned offset, ref<Expr> value);
   void write(ref<Expr> offset, ref<Expr> value);
@@ -235,14 +258,13 @@ public:
     if (!concreteMask)
         return true;
 
-    unsigned size = Expr::getMinBytesForWidth(width);
-    for(unsigned i = 0; i < size; ++i) {
-      if(!isByteConcrete(offset + i))
-        return false;
-    }
-    return true;
+    return concreteMask->isAllOnes(offset, Expr::getMinBytesForWidth(width));
   }
 
+  /// Lets clients cache facts derived from the concreteness of bytes,
+  /// see concreteMaskStamp.
+  uint64_t getConcreteMaskStamp() const { return concreteMaskStamp; }
+
   const uint8_t *getConcreteStore(bool allowSymbolic = false) const;
   uint8_t *getConcreteStore(bool allowSymolic = false);
 
@@ -254,6 +276,12 @@ private:
   void makeSymbolic();
 
   ref<Expr> read8(ref<Expr> offset) const;
+
+  /// Return the NumBytes bytes at offset as a single constant or Extract
+  /// if they are concrete or are the consecutive bytes of one symbolic
+  /// value, or null otherwise.
+  ref<Expr> readWhole(unsigned offset, unsigned NumBytes) const;
+
   void write8(unsigned offset, ref<Expr> value);
   void write8(ref<Expr> offset, ref<Expr> value);
 
@@ -275,12 +303,18 @@ private:
   }
 
   inline void markByteConcrete(unsigned offset) {
-      if (concreteMask)
+      if (concreteMask && !concreteMask->get(offset)) {
         concreteMask->set(offset);
+        concreteMaskChanged();
+      }
   }
 
   void markByteSymbolic(unsigned offset);
 
+  void concreteMaskChanged() {
+      concreteMaskStamp = nextConcreteMaskStamp();
+  }
+
   void markByteFlushed(unsigned offset);
 
   void markByteUnflushed(unsigned offset) {
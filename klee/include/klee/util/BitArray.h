@@ -10,6 +10,9 @@
 #ifndef KLEE_UTIL_BITARRAY_H
 #define KLEE_UTIL_BITARRAY_H
 
+#include <stdint.h>
+#include <string.h>
+
 namespace klee {
 
   // XXX would be nice not to have
@@ -24,6 +27,49 @@ private:
 protected:
   static uint32_t length(unsigned size) { return (size+31)/32; }
 
+  /// Mask of the bits [lo, hi) of a word, with lo < hi <= 32.
+  static uint32_t wordMask(unsigned lo, unsigned hi) {
+    uint32_t m = hi == 32 ? 0xffffffff : ((1u << hi) - 1);
+    return m & ~((1u << lo) - 1);
+  }
+
+  void fillRange(unsigned begin, unsigned count, bool value) {
+    if (!count)
+      return;
+    unsigned end = begin + count;
+    unsigned w = begin/32, we = (end-1)/32;
+    if (w == we) {
+      uint32_t m = wordMask(begin&0x1F, ((end-1)&0x1F)+1);
+      bits[w] = value ? (bits[w] | m) : (bits[w] & ~m);
+      return;
+    }
+
+    uint32_t m = wordMask(begin&0x1F, 32);
+    bits[w] = value ? (bits[w] | m) : (bits[w] & ~m);
+    if (we > w + 1)
+      memset(&bits[w+1], value?0xFF:0, sizeof(*bits)*(we-w-1));
+    m = wordMask(0, ((end-1)&0x1F)+1);
+    bits[we] = value ? (bits[we] | m) : (bits[we] & ~m);
+  }
+
+  /// Index of the first bit in [begin, end) equal to value, end if none.
+  unsigned findFirst(unsigned begin, unsigned end, bool value) const {
+    if (begin >= end)
+      return end;
+    unsigned w = begin/32, we = (end-1)/32;
+    uint32_t word = (value ? bits[w] : ~bits[w]) & wordMask(begin&0x1F, 32);
+    while (true) {
+      if (w == we)
+        word &= wordMask(0, ((end-1)&0x1F)+1);
+      if (word)
+        return w*32 + __builtin_ctz(word);
+      if (w == we)
+        return end;
+      ++w;
+      word = value ? bits[w] : ~bits[w];
+    }
+  }
+
 public:
   BitArray(unsigned size, bool value = false) : bits(new uint32_t[length(size)]) {
     memset(bits, value?0xFF:0, sizeof(*bits)*length(size));
@@ -33,25 +79,53 @@ public:
   }
   ~BitArray() { delete[] bits; }
 
-  inline bool get(unsigned idx) { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
+  inline bool get(unsigned idx) const { return (bool) ((bits[idx/32]>>(idx&0x1F))&1); }
   inline void set(unsigned idx) { bits[idx/32] |= 1<<(idx&0x1F); }
   inline void unset(unsigned idx) { bits[idx/32] &= ~(1<<(idx&0x1F)); }
   inline void set(unsigned idx, bool value) { if (value) set(idx); else unset(idx); }
 
-  bool isAllZeros(unsigned size) {
-    for(unsigned i = 0; i < size/32; ++i)
-      if(bits[i] != 0)
-        return false;
-    uint32_t mask = (1 << (size&0x1F)) - 1;
-    return (bits[size/32] & mask) == 0;
+  /// Set the bits [begin, begin+count).
+  void setRange(unsigned begin, unsigned count) { fillRange(begin, count, true); }
+
+  /// Clear the bits [begin, begin+count).
+  void unsetRange(unsigned begin, unsigned count) { fillRange(begin, count, false); }
+
+  /// Index of the first set bit in [begin, end), or end if there is none.
+  unsigned findFirstSet(unsigned begin, unsigned end) const {
+    return findFirst(begin, end, true);
   }
 
-  bool isAllOnes(unsigned size) {
-    for(unsigned i = 0; i < size/32; ++i)
-      if(bits[i] != 0xffffffff)
-        return false;
-    uint32_t mask = (1 << (size&0x1F)) - 1;
-    return (bits[size/32] & mask) == mask;
+  /// Index of the first clear bit in [begin, end), or end if there is none.
+  unsigned findFirstUnset(unsigned begin, unsigned end) const {
+    return findFirst(begin, end, false);
+  }
+
+  /// Whether all the bits [begin, begin+count) are set.
+  bool isAllOnes(unsigned begin, unsigned count) const {
+    return findFirstUnset(begin, begin + count) == begin + count;
+  }
+
+  /// Whether all the bits [begin, begin+count) are clear.
+  bool isAllZeros(unsigned begin, unsigned count) const {
+    return findFirstSet(begin, begin + count) == begin + count;
+  }
+
+  /// Whether at least one of the bits [begin, begin+count) is set.
+  bool isAnyOne(unsigned begin, unsigned count) const {
+    return !isAllZeros(begin, count);
+  }
+
+  bool isAllZeros(unsigned size) const { return isAllZeros(0, size); }
+  bool isAllOnes(unsigned size) const { return isAllOnes(0, size); }
+
+  /// Number of set bits among the first size bits.
+  unsigned count(unsigned size) const {
+    unsigned res = 0;
+    for (unsigned i = 0; i < size/32; ++i)
+      res += __builtin_popcount(bits[i]);
+    if (size & 0x1F)
+      res += __builtin_popcount(bits[size/32] & wordMask(0, size&0x1F));
+    return res;
   }
 };
 
@@ -0,0 +1,132 @@
+//===-- ExprStream.h --------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_EXPRSTREAM_H
+#define KLEE_EXPRSTREAM_H
+
+#include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace klee {
+
+  /// An expression stream is a sequence of records, each starting with a
+  /// varint tag followed by varint fields. Expressions are hash-consed: a
+  /// node, update or array is defined by its own record the first time it
+  /// is reachable from a written expression and is referred to by a
+  /// sequential id afterwards, so shared subterms are written once.
+  ///
+  /// Clients interleave their own records, with tags starting at
+  /// FirstUserRecord, that refer to expressions by id.
+  namespace ExprStream {
+    enum RecordTag {
+      ArrayRecord = 1,  ///< name, size, constant values
+      UpdateRecord,     ///< array, next update + 1 (0 if none), index, value
+      ExprRecord,       ///< kind, width, operands
+      ResetRecord,      ///< forget all ids defined so far
+
+      FirstUserRecord = 16
+    };
+  }
+
+  /// Records of the path constraint logs written by S2E's ConstraintTracer
+  /// and solved by klee-solve-log. Constraints are appended to sequences,
+  /// each started by a StateRecord or a ForkRecord under a new sequence id
+  /// and never modified otherwise, so that a ForkRecord always refers to
+  /// the constraints its parent had when it forked. A state gets a new
+  /// sequence when its constraints are replaced, e.g., by a merge.
+  namespace ConstraintLog {
+    enum RecordTag {
+      StateRecord = ExprStream::FirstUserRecord, ///< seq, state, count, ids
+      ForkRecord,       ///< seq, state, parent seq, parent constraints inherited
+      ConstraintRecord, ///< seq, pc, flags, id
+      KillRecord        ///< seq
+    };
+
+    enum ConstraintFlags {
+      BranchFlag = 1    ///< direction taken at a fork
+    };
+  }
+
+  class ExprStreamWriter {
+    std::vector<unsigned char> buffer;
+
+    ExprHashMap<unsigned> exprIds;
+    std::map<const Array*, unsigned> arrayIds;
+    std::map<const UpdateNode*, unsigned> updateIds;
+
+    unsigned writeArray(const Array *array);
+    unsigned writeUpdates(const Array *array, const UpdateNode *un);
+
+  public:
+    /// Define e and the parts of it not written yet, and return its id.
+    unsigned write(const ref<Expr> &e);
+
+    /// Define array if it was not written yet, and return its id. Arrays
+    /// and expressions are numbered separately.
+    unsigned write(const Array *array) { return writeArray(array); }
+
+    void writeVarint(uint64_t value);
+    void writeString(const std::string &s);
+
+    /// Forget all the definitions. Later writes define again the
+    /// expressions they use. This bounds the memory held by the writer.
+    void reset();
+
+    /// Number of distinct expressions defined since the last reset.
+    size_t getNumExprs() const { return exprIds.size(); }
+
+    /// Bytes written since the last call to clearBuffer().
+    const std::vector<unsigned char> &getBuffer() const { return buffer; }
+    void clearBuffer() { buffer.clear(); }
+  };
+
+  class ExprStreamReader {
+    const unsigned char *pos, *end;
+    bool error;
+
+    std::vector< ref<Expr> > exprs;
+    std::vector<const Array*> arrays; // never freed, like the parser's
+    std::vector<UpdateList> updates;
+
+    bool readArray();
+    bool readUpdate();
+    bool readExpr();
+
+  public:
+    ExprStreamReader(const unsigned char *_begin, const unsigned char *_end)
+      : pos(_begin), end(_end), error(false) {}
+
+    /// Process definition records up to the next client record and return
+    /// its tag, or 0 at the end of the stream or on a malformed record.
+    /// The client then reads the record fields.
+    unsigned nextRecord();
+
+    uint64_t readVarint();
+    std::string readString();
+
+    /// Return the expression with the given id, or null if undefined.
+    ref<Expr> getExpr(uint64_t id) const {
+      return id < exprs.size() ? exprs[id] : ref<Expr>(0);
+    }
+
+    /// Return the array with the given id, or null if undefined.
+    const Array *getArray(uint64_t id) const {
+      return id < arrays.size() ? arrays[id] : 0;
+    }
+
+    bool hasError() const { return error; }
+  };
+
+}
+
+#endif
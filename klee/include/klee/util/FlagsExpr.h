@@ -0,0 +1,144 @@
+//===-- FlagsExpr.h ---------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_FLAGSEXPR_H
+#define KLEE_FLAGSEXPR_H
+
+#include "klee/Expr.h"
+
+namespace klee {
+
+  // Target-independent builders for the x86 eflags of a pending lazy flags
+  // operation. The results match QEMU's compute_all_* functions bit for bit.
+
+  enum FlagsOpKind {
+    FLAGS_OP_ADD, FLAGS_OP_SUB, FLAGS_OP_LOGIC, FLAGS_OP_UNSUPPORTED
+  };
+
+  struct FlagsOperands {
+    ref<Expr> dst, src1, src2;
+  };
+
+  /// For a subtraction, QEMU stores CC_DST = src1 - src2 and CC_SRC = src2,
+  /// and the helpers recover src1 as CC_DST + CC_SRC. If CC_DST is literally
+  /// the subtraction, return its left operand instead so that the carry
+  /// flag becomes ult(src1, src2) instead of ult(add(sub(a,b),b),b).
+  inline ref<Expr> recoverMinuend(const ref<Expr> &dst, const ref<Expr> &src) {
+    ref<Expr> e = dst;
+    if (ExtractExpr *ee = dyn_cast<ExtractExpr>(e))
+      if (ee->offset == 0)
+        e = ee->expr;
+
+    if (SubExpr *se = dyn_cast<SubExpr>(e)) {
+      ref<Expr> left = se->left, right = se->right;
+      if (left->getWidth() >= src->getWidth()) {
+        if (right->getWidth() > src->getWidth())
+          right = ExtractExpr::create(right, 0, src->getWidth());
+        if (right == src)
+          return ExtractExpr::create(left, 0, src->getWidth());
+      }
+    }
+
+    return AddExpr::create(dst, src);
+  }
+
+  /// Rebuild the operands of the operation from the target-width CC_DST and
+  /// CC_SRC registers, truncated to the operand width.
+  inline FlagsOperands getFlagsOperands(FlagsOpKind kind,
+                                        const ref<Expr> &ccDst,
+                                        const ref<Expr> &ccSrc,
+                                        Expr::Width width) {
+    FlagsOperands ops;
+    ops.dst = ExtractExpr::create(ccDst, 0, width);
+    ref<Expr> src = ExtractExpr::create(ccSrc, 0, width);
+
+    switch (kind) {
+    case FLAGS_OP_ADD:
+      ops.src1 = src;
+      ops.src2 = SubExpr::create(ops.dst, src);
+      break;
+    case FLAGS_OP_SUB:
+      ops.src1 = recoverMinuend(ops.dst, src);
+      ops.src2 = src;
+      break;
+    default:
+      break;
+    }
+
+    return ops;
+  }
+
+  /// Bit 0 of the result is set if the low byte of value has even parity.
+  inline ref<Expr> computeParity(const ref<Expr> &value) {
+    ref<Expr> b = ExtractExpr::create(value, 0, Expr::Int8);
+    b = XorExpr::create(b, LShrExpr::create(b, ConstantExpr::create(4, Expr::Int8)));
+    b = XorExpr::create(b, LShrExpr::create(b, ConstantExpr::create(2, Expr::Int8)));
+    b = XorExpr::create(b, LShrExpr::create(b, ConstantExpr::create(1, Expr::Int8)));
+    return XorExpr::create(ExtractExpr::create(b, 0, Expr::Bool),
+                           ConstantExpr::create(1, Expr::Bool));
+  }
+
+  inline ref<Expr> flagsMsb(const ref<Expr> &value) {
+    return ExtractExpr::create(value, value->getWidth() - 1, Expr::Bool);
+  }
+
+  /// Place a boolean expression at the given bit position of a 32-bit word.
+  inline ref<Expr> flagsBit(const ref<Expr> &b, unsigned shift) {
+    ref<Expr> r = ZExtExpr::create(b, Expr::Int32);
+    if (shift)
+      r = ShlExpr::create(r, ConstantExpr::create(shift, Expr::Int32));
+    return r;
+  }
+
+  inline ref<Expr> computeCarry(FlagsOpKind kind, const FlagsOperands &ops) {
+    switch (kind) {
+    case FLAGS_OP_ADD: return UltExpr::create(ops.dst, ops.src1);
+    case FLAGS_OP_SUB: return UltExpr::create(ops.src1, ops.src2);
+    default: return ConstantExpr::create(0, Expr::Bool);
+    }
+  }
+
+  /// The CF, PF, AF, ZF, SF and OF bits, as returned by helper_cc_compute_all.
+  inline ref<Expr> computeAllFlags(FlagsOpKind kind, const FlagsOperands &ops) {
+    const ref<Expr> &dst = ops.dst;
+    Expr::Width w = dst->getWidth();
+
+    ref<Expr> cf = computeCarry(kind, ops);
+    ref<Expr> pf = computeParity(dst);
+    ref<Expr> zf = EqExpr::create(dst, ConstantExpr::create(0, w));
+    ref<Expr> sf = flagsMsb(dst);
+
+    ref<Expr> res = OrExpr::create(flagsBit(cf, 0), flagsBit(pf, 2));
+    res = OrExpr::create(res, flagsBit(zf, 6));
+    res = OrExpr::create(res, flagsBit(sf, 7));
+
+    if (kind != FLAGS_OP_LOGIC) {
+      const ref<Expr> &src1 = ops.src1, &src2 = ops.src2;
+
+      // af = (dst ^ src1 ^ src2) & 0x10
+      ref<Expr> af = ExtractExpr::create(
+          XorExpr::create(XorExpr::create(dst, src1), src2), 4, Expr::Bool);
+
+      // add: of = msb(~(src1 ^ src2) & (src1 ^ dst))
+      // sub: of = msb((src1 ^ src2) & (src1 ^ dst))
+      ref<Expr> x = XorExpr::create(src1, src2);
+      if (kind == FLAGS_OP_ADD)
+        x = NotExpr::create(x);
+      ref<Expr> of = flagsMsb(AndExpr::create(x, XorExpr::create(src1, dst)));
+
+      res = OrExpr::create(res, flagsBit(af, 4));
+      res = OrExpr::create(res, flagsBit(of, 11));
+    }
+
+    return res;
+  }
+
+}
+
+#endif
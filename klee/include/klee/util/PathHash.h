@@ -0,0 +1,39 @@
+//===-- PathHash.h ----------------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_PATHHASH_H
+#define KLEE_PATHHASH_H
+
+#include <stdint.h>
+
+namespace klee {
+
+  /// Folds the bytes of val into the FNV-1a hash initial.
+  inline uint64_t hash64(uint64_t val,
+                         uint64_t initial = 14695981039346656037ULL) {
+    const unsigned char *p = (const unsigned char*) &val;
+    for (unsigned i = 0; i < sizeof(uint64_t); ++i) {
+      initial ^= p[i];
+      initial *= 1099511628211ULL;
+    }
+    return initial;
+  }
+
+  /// Path hash of a state that took the given direction at a fork at pc.
+  /// The direction is the side of a two-way fork (0 for the true side) or
+  /// the index of the condition in a multi-way branch, never the position
+  /// of the state among the feasible results.
+  inline uint64_t forkPathHash(uint64_t pathHash, uint64_t pc,
+                               unsigned direction) {
+    return hash64(direction, hash64(pc, pathHash));
+  }
+
+}
+
+#endif
@@ -23,6 +23,32 @@ using llvm::dyn_cast_or_null;
 
 namespace klee {
 
+/// refInc, refDec - Update the reference count of an object shared by
+/// ref<> or UpdateList. refDec returns the count after the decrement.
+///
+/// The updates are plain increments unless KLEE is built with
+/// KLEE_THREADSAFE_REFS (THREADSAFE_REFS=1 on the make command line),
+/// which makes them atomic so that expressions can be shared between
+/// threads. Everything that shares expressions, S2E included, must be
+/// built with the same setting.
+#ifdef KLEE_THREADSAFE_REFS
+inline void refInc(unsigned &count) {
+  __sync_fetch_and_add(&count, 1);
+}
+
+inline unsigned refDec(unsigned &count) {
+  return __sync_sub_and_fetch(&count, 1);
+}
+#else
+inline void refInc(unsigned &count) {
+  ++count;
+}
+
+inline unsigned refDec(unsigned &count) {
+  return --count;
+}
+#endif
+
 template<class T>
 class ref {
   T *ptr;
@@ -35,11 +61,11 @@ public:
 private:
   void inc() {
     if (ptr)
-      ++ptr->refCount;
+      refInc(ptr->refCount);
   }
   
   void dec() {
-    if (ptr && --ptr->refCount == 0)
+    if (ptr && refDec(ptr->refCount) == 0)
       delete ptr;
   }  
 
@@ -28,7 +28,10 @@ void AddressSpace::bindObject(const MemoryObject *mo, ObjectState *os) {
 
   assert(os->copyOnWriteOwner==0 && "object already has owner");
   os->copyOnWriteOwner = cowKey;
-  objects = objects.replace(std::make_pair(mo, os));
+  if (RamRegion *region = findRamRegion(mo))
+    region->objects.set(region->index(mo->address), os);
+  else
+    objects = objects.replace(std::make_pair(mo, os));
 }
 
 void AddressSpace::unbindObject(const MemoryObject *mo) {
@@ -36,16 +39,28 @@ void AddressSpace::unbindObject(const MemoryObject *mo) {
   const ObjectState *os = findObject(mo);
   if(os) state->addressSpaceChange(mo, os, NULL);
 
-  objects = objects.remove(mo);
+  if (RamRegion *region = findRamRegion(mo))
+    region->objects.set(region->index(mo->address), ObjectHolder());
+  else
+    objects = objects.remove(mo);
 }
 
 const ObjectState *AddressSpace::findObject(const MemoryObject *mo) const {
+  if (const RamRegion *region = findRamRegion(mo))
+    return region->objects.get(region->index(mo->address));
+
   const MemoryMap::value_type *res = objects.lookup(mo);
   
   return res ? res->second : 0;
 }
 
 ObjectPair AddressSpace::findObject(uint64_t address) const {
+  if (const RamRegion *region = findRamRegion(address)) {
+    const ObjectState *os = region->objects.get(region->index(address));
+    if (os && os->getObject()->address == address)
+      return ObjectPair(os->getObject(), os);
+  }
+
   MemoryObject hack(address);
   const MemoryMap::value_type *res = objects.lookup(&hack);
   return res ? ObjectPair(*res) : ObjectPair(NULL, NULL);
@@ -64,7 +79,10 @@ ObjectState *AddressSpace::getWriteable(const MemoryObject *mo,
     assert(state);
     state->addressSpaceChange(mo, os, n);
 
-    objects = objects.replace(std::make_pair(mo, n));
+    if (RamRegion *region = findRamRegion(mo))
+      region->objects.set(region->index(mo->address), n);
+    else
+      objects = objects.replace(std::make_pair(mo, n));
     return n;    
   }
 }
@@ -74,11 +92,72 @@ bool AddressSpace::isOwnedByUs(const ObjectState *os) const
     return cowKey==os->copyOnWriteOwner;
 }
 
+void AddressSpace::registerRamRegion(uint64_t base, uint64_t size,
+                                     unsigned objectBits) {
+  uint64_t objectSize = 1ULL << objectBits;
+  assert((base & (objectSize - 1)) == 0 && "unaligned RAM region");
+  assert(!findRamRegion(base) && !findRamRegion(base + size - 1) &&
+         "overlapping RAM regions");
+
+  RamRegion region;
+  region.base = base;
+  region.size = size;
+  region.objectBits = objectBits;
+  region.objects = ImmutableRadixArray<ObjectHolder>(
+                       (size + objectSize - 1) >> objectBits);
+
+  // Most accesses fall in the largest region, so keep it first.
+  std::vector<RamRegion>::iterator it = ramRegions.begin();
+  while (it != ramRegions.end() && it->size >= size)
+    ++it;
+  ramRegions.insert(it, region);
+}
+
+RamRegion *AddressSpace::findRamRegion(const MemoryObject *mo) {
+  const AddressSpace *self = this;
+  return const_cast<RamRegion*>(self->findRamRegion(mo));
+}
+
+const RamRegion *AddressSpace::findRamRegion(const MemoryObject *mo) const {
+  const RamRegion *region = findRamRegion(mo->address);
+  if (region && mo->size == (1ULL << region->objectBits) &&
+      ((mo->address - region->base) & (mo->size - 1)) == 0)
+    return region;
+  return NULL;
+}
+
+void AddressSpace::getChangedRamObjects(const AddressSpace &b,
+         std::vector<std::pair<const ObjectState*,
+                               const ObjectState*> > &result) const {
+  assert(ramRegions.size() == b.ramRegions.size());
+  std::vector<size_t> indices;
+  for (unsigned i = 0; i < ramRegions.size(); ++i) {
+    const RamRegion &ra = ramRegions[i], &rb = b.ramRegions[i];
+    assert(ra.base == rb.base && ra.size == rb.size);
+
+    indices.clear();
+    ra.objects.diff(rb.objects, indices);
+    for (unsigned j = 0; j < indices.size(); ++j) {
+      const ObjectState *os = ra.objects.get(indices[j]);
+      const ObjectState *otherOS = rb.objects.get(indices[j]);
+      result.push_back(std::make_pair(os, otherOS));
+    }
+  }
+}
+
 /// 
 
 bool AddressSpace::resolveOne(const ref<ConstantExpr> &addr, 
                               ObjectPair &result) {
   uint64_t address = addr->getZExtValue();
+
+  if (const RamRegion *region = findRamRegion(address)) {
+    if (const ObjectState *os = region->objects.get(region->index(address))) {
+      result = ObjectPair(os->getObject(), os);
+      return true;
+    }
+  }
+
   MemoryObject hack(address);
 
   if (const MemoryMap::value_type *res = objects.lookup_previous(&hack)) {
@@ -174,6 +253,15 @@ bool AddressSpace::resolveOne(ExecutionState &state,
     if (!solver->getValue(state, address, cex))
       return false;
     uint64_t example = cex->getZExtValue();
+
+    if (const RamRegion *region = findRamRegion(example)) {
+      if (const ObjectState *os = region->objects.get(region->index(example))) {
+        result = ObjectPair(os->getObject(), os);
+        success = true;
+        return true;
+      }
+    }
+
     MemoryObject hack(example);
     const MemoryMap::value_type *res = objects.lookup_previous(&hack);
     
@@ -247,6 +335,110 @@ bool AddressSpace::resolveOne(ExecutionState &state,
   }
 }
 
+bool AddressSpace::resolveRam(ExecutionState &state,
+                              TimingSolver *solver,
+                              ref<Expr> p,
+                              uint64_t example,
+                              ResolutionList &rl,
+                              unsigned maxResolutions,
+                              uint64_t timeout_us,
+                              TimerStatIncrementer &timer,
+                              bool &incomplete) {
+  const RamRegion *region = findRamRegion(example);
+  if (!region)
+    return false;
+  size_t start = region->index(example);
+  if (!region->objects.get(start))
+    return false;
+
+  // Any early exit below is due to a solver failure or a timeout.
+  incomplete = true;
+
+  // search backwards from the object containing the example, then
+  // forwards, in the same way as resolve() walks the object map
+  for (size_t i = start + 1; i-- > 0; ) {
+    const ObjectState *os = region->objects.get(i);
+    if (!os)
+      break;
+    const MemoryObject *mo = os->getObject();
+    if (timeout_us && timeout_us < timer.check())
+      return true;
+
+    ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
+      return true;
+    if (mayBeTrue) {
+      rl.push_back(ObjectPair(mo, os));
+
+      // fast path check
+      unsigned size = rl.size();
+      if (size==1) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
+          return true;
+        if (mustBeTrue) {
+          incomplete = false;
+          return true;
+        }
+      } else if (size==maxResolutions) {
+        return true;
+      }
+    }
+
+    bool mustBeTrue;
+    if (!solver->mustBeTrue(state,
+                            UgeExpr::create(p, mo->getBaseExpr()),
+                            mustBeTrue))
+      return true;
+    if (mustBeTrue)
+      break;
+  }
+
+  for (size_t i = start + 1; i < region->objects.size(); ++i) {
+    const ObjectState *os = region->objects.get(i);
+    if (!os)
+      break;
+    const MemoryObject *mo = os->getObject();
+    if (timeout_us && timeout_us < timer.check())
+      return true;
+
+    bool mustBeTrue;
+    if (!solver->mustBeTrue(state,
+                            UltExpr::create(p, mo->getBaseExpr()),
+                            mustBeTrue))
+      return true;
+    if (mustBeTrue)
+      break;
+
+    ref<Expr> inBounds = mo->getBoundsCheckPointer(p);
+    bool mayBeTrue;
+    if (!solver->mayBeTrue(state, inBounds, mayBeTrue))
+      return true;
+    if (mayBeTrue) {
+      rl.push_back(ObjectPair(mo, os));
+
+      // fast path check
+      unsigned size = rl.size();
+      if (size==1) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(state, inBounds, mustBeTrue))
+          return true;
+        if (mustBeTrue) {
+          incomplete = false;
+          return true;
+        }
+      } else if (size==maxResolutions) {
+        return true;
+      }
+    }
+  }
+
+  // Objects outside the region may still match, let the caller search
+  // the object map as well.
+  return false;
+}
+
 bool AddressSpace::resolve(ExecutionState &state,
                            TimingSolver *solver, 
                            ref<Expr> p, 
@@ -281,6 +473,12 @@ bool AddressSpace::resolve(ExecutionState &state,
     if (!solver->getValue(state, p, cex))
       return true;
     uint64_t example = cex->getZExtValue();
+
+    bool incomplete;
+    if (resolveRam(state, solver, p, example, rl, maxResolutions,
+                   timeout_us, timer, incomplete))
+      return incomplete;
+
     MemoryObject hack(example);
     
     MemoryMap::iterator oi = objects.upper_bound(&hack);
@@ -88,10 +88,6 @@ namespace {
   DumpStatesOnHalt("dump-states-on-halt",
                    cl::init(true));
  
-  cl::opt<bool>
-  NoPreferCex("no-prefer-cex",
-              cl::init(false));
- 
   cl::opt<bool>
   UseAsmAddresses("use-asm-addresses",
                   cl::init(false));
@@ -121,6 +117,19 @@ namespace {
   MaxSymArraySize("max-sym-array-size",
                   cl::init(0));
 
+  cl::opt<unsigned>
+  MaxExprSize("max-expr-size",
+              cl::desc("Concretize stored values and branch conditions "
+                       "whose expression has more distinct nodes than this "
+                       "(default=0 (off))"),
+              cl::init(0));
+
+  cl::opt<unsigned>
+  MaxExprDepth("max-expr-depth",
+               cl::desc("Concretize stored values and branch conditions "
+                        "deeper than this (default=0 (off))"),
+               cl::init(0));
+
   cl::opt<bool>
   DebugValidateSolver("debug-validate-solver",
 		      cl::init(false));
@@ -279,6 +288,10 @@ UseExprSimplifier("use-expr-simplifier",
           cl::desc("Apply expression simplifier for new expressions"),
           cl::init(true));
 
+cl::opt<bool>
+NoPreferCex("no-prefer-cex",
+            cl::init(false));
+
 
 
 unsigned Executor::getMaxMemory() { return MaxMemory; }
@@ -377,6 +390,8 @@ Executor::Executor(const InterpreterOptions &opts,
 
   //Mandatory for AddressSpace
   exprSimplifier = new BitfieldSimplifier;
+
+  constantPoolLimit = 4096;
 }
 
 
@@ -1300,7 +1315,7 @@ void Executor::bindArgument(KFunction *kf, unsigned index,
   getArgumentCell(state, kf, index).value = simplifyExpr(state, value);
 }
 
-ref<Expr> Executor::toUnique(const ExecutionState &state, ref<Expr> &e)
+ref<Expr> Executor::toUnique(ExecutionState &state, ref<Expr> &e)
 {
     e = simplifyExpr(state, e);
     ref<Expr> result = e;
@@ -1309,6 +1324,13 @@ ref<Expr> Executor::toUnique(const ExecutionState &state, ref<Expr> &e)
         return result;
     }
 
+    // The value was proven unique before, or is fixed by the constraints
+    ref<Expr> known = state.constraints.simplifyExpr(e);
+    if (isa<ConstantExpr>(known)) {
+        ++stats::uniqueValueHits;
+        return known;
+    }
+
     ref<ConstantExpr> value;
     bool isTrue = false;
 
@@ -1328,6 +1350,7 @@ ref<Expr> Executor::toUnique(const ExecutionState &state, ref<Expr> &e)
 
     if (success && isTrue) {
         result = value;
+        state.constraints.addImpliedEquality(e, value);
     }
 
     solver->setTimeout(0);
@@ -1394,6 +1417,26 @@ Executor::toConstantSilent(ExecutionState &state,
   return value;
 }
 
+ref<Expr> Executor::limitExprComplexity(ExecutionState &state, ref<Expr> e) {
+  if (isa<ConstantExpr>(e))
+    return e;
+  // The tree size bounds the DAG size and is free, only walk the DAG of
+  // expressions whose subterms are shared enough to make a difference.
+  if ((!MaxExprSize || e->getTreeSize() <= MaxExprSize ||
+       e->computeDagSize(MaxExprSize) <= MaxExprSize) &&
+      (!MaxExprDepth || e->getDepth() <= MaxExprDepth))
+    return e;
+
+  // toConstant without the warning: complex expressions are expected to
+  // be frequent once a budget is set, they are reported per site instead.
+  ref<ConstantExpr> value = toConstantSilent(state, e);
+  addConstraint(state, EqExpr::create(e, value));
+
+  ++stats::concretizedExprs;
+  notifyExprConcretized(state, e);
+  return value;
+}
+
 void Executor::executeGetValue(ExecutionState &state,
                                ref<Expr> e,
                                KInstruction *target) {
@@ -2653,11 +2696,47 @@ void Executor::bindModuleConstants() {
       bindInstructionConstants(kf->instructions[i]);
   }
 
+  bindConstants(0);
+}
+
+void Executor::bindConstants(unsigned begin) {
   kmodule->constantTable.resize(kmodule->constants.size());
-  for (unsigned i=0; i<kmodule->constants.size(); ++i) {
+  for (unsigned i=begin; i<kmodule->constants.size(); ++i) {
     Cell &c = kmodule->constantTable[i];
-    c.value = evalConstant(kmodule->constants[i]);
+    c.value = internConstant(evalConstant(kmodule->constants[i]));
+    ++stats::constants;
+  }
+}
+
+ref<klee::ConstantExpr> Executor::internConstant(const ref<ConstantExpr> &c) {
+  // Wider values are rare (aggregates), keep them apart.
+  if (c->getWidth() > 64)
+    return c;
+
+  std::pair<Expr::Width, uint64_t> key(c->getWidth(), c->getZExtValue());
+  std::map<std::pair<Expr::Width, uint64_t>, ref<ConstantExpr> >::iterator it =
+    constantPool.find(key);
+  if (it != constantPool.end())
+    return it->second;
+
+  if (constantPool.size() >= constantPoolLimit)
+    purgeConstantPool();
+
+  constantPool.insert(std::make_pair(key, c));
+  return c;
+}
+
+void Executor::purgeConstantPool() {
+  for (std::map<std::pair<Expr::Width, uint64_t>, ref<ConstantExpr> >::iterator
+         it = constantPool.begin(), ie = constantPool.end(); it != ie; ) {
+    if (it->second->refCount == 1)
+      constantPool.erase(it++);
+    else
+      ++it;
   }
+
+  // Purging again only once the pool doubled keeps the cost amortized.
+  constantPoolLimit = std::max<size_t>(4096, 2 * constantPool.size());
 }
 
 void Executor::run(ExecutionState &initialState) {
@@ -3335,6 +3414,9 @@ void Executor::executeMemoryOperation(ExecutionState &state,
       value = state.constraints.simplifyExpr(value);
   }
 
+  if (isWrite)
+    value = limitExprComplexity(state, value);
+
   // fast path: single in-bounds resolution
   ObjectPair op;
   bool success;
@@ -89,6 +89,8 @@ void MemoryObject::getAllocInfo(std::string &result) const {
 
 /***/
 
+uint64_t ObjectState::lastConcreteMaskStamp = 0;
+
 ObjectState::ObjectState(const MemoryObject *mo)
   : concreteMask(0),
     copyOnWriteOwner(0),
@@ -98,6 +100,7 @@ ObjectState::ObjectState(const MemoryObject *mo)
     flushMask(0),
     knownSymbolics(0),
     updates(0, 0),
+    concreteMaskStamp(nextConcreteMaskStamp()),
     size(mo->size),
     readOnly(false)
      {
@@ -119,6 +122,7 @@ ObjectState::ObjectState(const MemoryObject *mo, const Array *array)
     flushMask(0),
     knownSymbolics(0),
     updates(array, 0),
+    concreteMaskStamp(nextConcreteMaskStamp()),
     size(mo->size),
     readOnly(false)
  {
@@ -134,6 +138,7 @@ ObjectState::ObjectState(const ObjectState &os)
     flushMask(os.flushMask ? new BitArray(*os.flushMask, os.size) : 0),
     knownSymbolics(0),
     updates(os.updates),
+    concreteMaskStamp(os.concreteMaskStamp),
     size(os.size),
     readOnly(false)
      {
@@ -220,17 +225,27 @@ void ObjectState::makeConcrete() {
   concreteMask = 0;
   flushMask = 0;
   knownSymbolics = 0;
+  concreteMaskChanged();
 }
 
 void ObjectState::makeSymbolic() {
   assert(!updates.head &&
          "XXX makeSymbolic of objects with symbolic values is unsupported");
 
-  // XXX simplify this, can just delete various arrays I guess
-  for (unsigned i=0; i<size; i++) {
-    markByteSymbolic(i);
-    setKnownSymbolic(i, 0);
-    markByteFlushed(i);
+  if (!concreteMask)
+    concreteMask = new BitArray(size, false);
+  else
+    concreteMask->unsetRange(0, size);
+  concreteMaskChanged();
+
+  if (!flushMask)
+    flushMask = new BitArray(size, false);
+  else
+    flushMask->unsetRange(0, size);
+
+  if (knownSymbolics) {
+    delete[] knownSymbolics;
+    knownSymbolics = 0;
   }
 }
 
@@ -265,51 +280,60 @@ void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
                                     unsigned rangeSize) const {
   if (!flushMask) flushMask = new BitArray(size, true);
- 
-  for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-      }
 
-      flushMask->unset(offset);
+  unsigned rangeEnd = rangeBase + rangeSize;
+
+  // Only visit the bytes that are not flushed yet
+  for (unsigned offset = flushMask->findFirstSet(rangeBase, rangeEnd);
+       offset < rangeEnd;
+       offset = flushMask->findFirstSet(offset + 1, rangeEnd)) {
+    if (isByteConcrete(offset)) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(concreteStore[offset], Expr::Int8));
+    } else {
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics[offset]);
     }
-  } 
+  }
+
+  flushMask->unsetRange(rangeBase, rangeSize);
 }
 
 void ObjectState::flushRangeForWrite(unsigned rangeBase, 
                                      unsigned rangeSize) {
   if (!flushMask) flushMask = new BitArray(size, true);
 
-  for (unsigned offset=rangeBase; offset<rangeBase+rangeSize; offset++) {
-    if (!isByteFlushed(offset)) {
-      if (isByteConcrete(offset)) {
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       ConstantExpr::create(concreteStore[offset], Expr::Int8));
-        markByteSymbolic(offset);
-      } else {
-        assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
-        updates.extend(ConstantExpr::create(offset, Expr::Int32),
-                       knownSymbolics[offset]);
-        setKnownSymbolic(offset, 0);
-      }
+  unsigned rangeEnd = rangeBase + rangeSize;
 
-      flushMask->unset(offset);
+  for (unsigned offset = flushMask->findFirstSet(rangeBase, rangeEnd);
+       offset < rangeEnd;
+       offset = flushMask->findFirstSet(offset + 1, rangeEnd)) {
+    if (isByteConcrete(offset)) {
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     ConstantExpr::create(concreteStore[offset], Expr::Int8));
     } else {
-      // flushed bytes that are written over still need
-      // to be marked out
-      if (isByteConcrete(offset)) {
-        markByteSymbolic(offset);
-      } else if (isByteKnownSymbolic(offset)) {
-        setKnownSymbolic(offset, 0);
-      }
+      assert(isByteKnownSymbolic(offset) && "invalid bit set in flushMask");
+      updates.extend(ConstantExpr::create(offset, Expr::Int32),
+                     knownSymbolics[offset]);
     }
-  } 
+  }
+
+  flushMask->unsetRange(rangeBase, rangeSize);
+
+  // All the bytes of the range, flushed or not, are now only
+  // available through the update list
+  if (!concreteMask)
+    concreteMask = new BitArray(size, true);
+  if (concreteMask->isAnyOne(rangeBase, rangeSize)) {
+    concreteMask->unsetRange(rangeBase, rangeSize);
+    concreteMaskChanged();
+  }
+
+  if (knownSymbolics) {
+    for (unsigned offset = rangeBase; offset < rangeEnd; ++offset)
+      knownSymbolics[offset] = 0;
+  }
 }
 
 bool ObjectState::isAllConcrete() const {
@@ -338,7 +362,10 @@ uint8_t *ObjectState::getConcreteStore(bool allowSymbolic)
 void ObjectState::markByteSymbolic(unsigned offset) {
   if (!concreteMask)
     concreteMask = new BitArray(size, true);
+  else if (!concreteMask->get(offset))
+    return;
   concreteMask->unset(offset);
+  concreteMaskChanged();
 }
 
 
@@ -475,15 +502,62 @@ ref<Expr> ObjectState::read(ref<Expr> offset, Expr::Width width) const {
   return Res;
 }
 
+ref<Expr> ObjectState::readWhole(unsigned offset, unsigned NumBytes) const {
+  bool littleEndian = Context::get().isLittleEndian();
+
+  if (NumBytes <= 8) {
+    uint8_t buf[8];
+    if (readConcrete(offset, buf, NumBytes)) {
+      uint64_t value = 0;
+      for (unsigned i = 0; i != NumBytes; ++i) {
+        unsigned idx = littleEndian ? i : (NumBytes - i - 1);
+        value |= (uint64_t) buf[idx] << (i * 8);
+      }
+      return ConstantExpr::create(value, NumBytes * 8);
+    }
+  }
+
+  // The bytes of a symbolic value written at once are stored as
+  // Extracts of that value.
+  if (object->isSharedConcrete)
+    return ref<Expr>(0);
+
+  const ExtractExpr *first = 0;
+  for (unsigned i = 0; i != NumBytes; ++i) {
+    unsigned idx = littleEndian ? i : (NumBytes - i - 1);
+    if (isByteConcrete(offset + idx) || !isByteKnownSymbolic(offset + idx))
+      return ref<Expr>(0);
+    const ExtractExpr *ee =
+      dyn_cast<ExtractExpr>(knownSymbolics[offset + idx].get());
+    if (!ee || ee->width != Expr::Int8)
+      return ref<Expr>(0);
+    if (!first)
+      first = ee;
+    else if (ee->expr != first->expr || ee->offset != first->offset + i * 8)
+      return ref<Expr>(0);
+  }
+
+  return ExtractExpr::create(first->expr, first->offset, NumBytes * 8);
+}
+
 ref<Expr> ObjectState::read(unsigned offset, Expr::Width width) const {
   // Treat bool specially, it is the only non-byte sized write we allow.
   if (width == Expr::Bool)
     return ExtractExpr::create(read8(offset), 0, Expr::Bool);
 
-  // Otherwise, follow the slow general case.
   unsigned NumBytes = width / 8;
   assert(width == NumBytes * 8 && "Invalid write size!");
+
+  // Fast path: build the value directly instead of folding a Concat
+  // per byte.
   ref<Expr> Res(0);
+  if (NumBytes > 1) {
+    Res = readWhole(offset, NumBytes);
+    if (!Res.isNull())
+      return Res;
+  }
+
+  // Otherwise, follow the slow general case.
   for (unsigned i = 0; i != NumBytes; ++i) {
     unsigned idx = Context::get().isLittleEndian() ? i : (NumBytes - i - 1);
     ref<Expr> Byte = read8(offset + idx);
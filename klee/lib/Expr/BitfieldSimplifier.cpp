@@ -34,6 +34,7 @@
  */
 
 #include "klee/BitfieldSimplifier.h"
+#include "klee/CoreStats.h"
 
 #include <klee/Common.h>
 #include "llvm/Support/CommandLine.h"
@@ -56,6 +57,12 @@ namespace {
     cl::opt<bool>
     PrintSimplifier("print-expr-simplifier",
                 cl::init(false));
+
+    cl::opt<unsigned>
+    SimplifierCacheSize("expr-simplifier-cache-size",
+                cl::desc("Number of expressions whose simplification is "
+                         "remembered (default=100000)"),
+                cl::init(100000));
 }
 
 ref<Expr> BitfieldSimplifier::replaceWithConstant(ref<Expr> e, uint64_t value)
@@ -88,6 +95,18 @@ BitfieldSimplifier::ExprBitsInfo BitfieldSimplifier::doSimplifyBits(
         }
     }
 
+    /* Without ignored bits the result only depends on e */
+    if(!ignoredBits && e->getNumKids() > 0) {
+        ExprHashMap<ExprBitsInfo>::iterator sit = m_simplifiedCache.find(e);
+        if(sit != m_simplifiedCache.end()) {
+            ++stats::simplifierCacheHits;
+            return sit->second;
+        }
+        ++stats::simplifierCacheMisses;
+    }
+
+    ref<Expr> original = e;
+
     ref<Expr> kids[8];
     BitsInfo bits[8];
     uint64_t oldIgnoredBits[8];
@@ -362,10 +381,20 @@ BitfieldSimplifier::ExprBitsInfo BitfieldSimplifier::doSimplifyBits(
         }
     }
 
+    if(m_bitsInfoCache.size() >= SimplifierCacheSize ||
+       m_simplifiedCache.size() >= SimplifierCacheSize) {
+        m_bitsInfoCache.clear();
+        m_simplifiedCache.clear();
+    }
+
     /* Cache knownBits information, but only for complex expressions */
     if(e->getNumKids() > 1)
         m_bitsInfoCache.insert(std::make_pair(e, rbits));
 
+    if(!ignoredBits && original->getNumKids() > 0)
+        m_simplifiedCache.insert(std::make_pair(original,
+                                                std::make_pair(e, rbits)));
+
     return std::make_pair(e, rbits);
 }
 
@@ -79,6 +79,10 @@ bool ConstraintManager::rewriteConstraints(ExprVisitor &visitor) {
     }
   }
 
+  // The rewritten constraints are still in the index
+  if (changed)
+    indexed = false;
+
   return changed;
 }
 
@@ -86,31 +90,46 @@ void ConstraintManager::simplifyForValidConstraint(ref<Expr> e) {
   // XXX 
 }
 
+void ConstraintManager::indexConstraint(const ref<Expr> &e) const {
+  if (const EqExpr *ee = dyn_cast<EqExpr>(e)) {
+    if (isa<ConstantExpr>(ee->left)) {
+      equalities.insert(std::make_pair(ee->right,
+                                       ee->left));
+      return;
+    }
+  }
+  equalities.insert(std::make_pair(e,
+                                   ConstantExpr::alloc(1, Expr::Bool)));
+}
+
 ref<Expr> ConstraintManager::simplifyExpr(ref<Expr> e) const {
   if (isa<ConstantExpr>(e))
     return e;
 
-  std::map< ref<Expr>, ref<Expr> > equalities;
-  
-  for (ConstraintManager::constraints_ty::const_iterator 
-         it = constraints.begin(), ie = constraints.end(); it != ie; ++it) {
-    if (const EqExpr *ee = dyn_cast<EqExpr>(*it)) {
-      if (isa<ConstantExpr>(ee->left)) {
-        equalities.insert(std::make_pair(ee->right,
-                                         ee->left));
-      } else {
-        equalities.insert(std::make_pair(*it,
-                                         ConstantExpr::alloc(1, Expr::Bool)));
-      }
-    } else {
-      equalities.insert(std::make_pair(*it,
-                                       ConstantExpr::alloc(1, Expr::Bool)));
-    }
+  if (!indexed) {
+    equalities.clear();
+    for (ConstraintManager::constraints_ty::const_iterator 
+           it = constraints.begin(), ie = constraints.end(); it != ie; ++it)
+      indexConstraint(*it);
+    equalities.insert(implied.begin(), implied.end());
+    indexed = true;
   }
 
+  if (equalities.empty())
+    return e;
+
   return ExprReplaceVisitor2(equalities).visit(e);
 }
 
+void ConstraintManager::addImpliedEquality(ref<Expr> e,
+                                           ref<ConstantExpr> value) {
+  if (isa<ConstantExpr>(e))
+    return;
+  implied.insert(std::make_pair(e, value));
+  if (indexed)
+    equalities.insert(std::make_pair(e, value));
+}
+
 void ConstraintManager::addConstraintInternal(ref<Expr> e) {
   // rewrite any known equalities 
 
@@ -141,11 +160,15 @@ void ConstraintManager::addConstraintInternal(ref<Expr> e) {
       rewriteConstraints(visitor);
     }
     constraints.push_back(e);
+    if (indexed)
+      indexConstraint(e);
     break;
   }
     
   default:
     constraints.push_back(e);
+    if (indexed)
+      indexConstraint(e);
     break;
   }
 }
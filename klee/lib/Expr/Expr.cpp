@@ -18,6 +18,8 @@
 #include "klee/util/ExprPPrinter.h"
 #include <llvm/Support/raw_os_ostream.h>
 
+#include <climits>
+#include <set>
 #include <iostream>
 #include <sstream>
 
@@ -193,6 +195,51 @@ unsigned NotExpr::computeHash() {
   return hashValue;
 }
 
+void Expr::computeComplexity() {
+  uint64_t size = 1;
+  unsigned d = 0;
+
+  unsigned n = getNumKids();
+  for (unsigned i = 0; i < n; i++) {
+    const Expr *kid = getKid(i).get();
+    size += kid->treeSize;
+    if (kid->depth >= d)
+      d = kid->depth + 1;
+  }
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(this))
+    size += re->updates.getSize();
+
+  treeSize = size > UINT_MAX ? UINT_MAX : (unsigned) size;
+  depth = d;
+}
+
+unsigned Expr::computeDagSize(unsigned limit) const {
+  std::set<const Expr*> visited;
+  std::set<const UpdateNode*> updates;
+  std::vector<const Expr*> stack;
+
+  visited.insert(this);
+  stack.push_back(this);
+  while (!stack.empty() && (!limit || visited.size() + updates.size() <= limit)) {
+    const Expr *e = stack.back();
+    stack.pop_back();
+
+    for (unsigned i = 0, n = e->getNumKids(); i < n; i++) {
+      const Expr *kid = e->getKid(i).get();
+      if (visited.insert(kid).second)
+        stack.push_back(kid);
+    }
+
+    // Like the tree size, count the update nodes but not their contents.
+    if (const ReadExpr *re = dyn_cast<ReadExpr>(e))
+      for (const UpdateNode *un = re->updates.head; un; un = un->next)
+        if (!updates.insert(un).second)
+          break;
+  }
+
+  return visited.size() + updates.size();
+}
+
 ref<Expr> Expr::createFromKind(Kind k, std::vector<CreateArg> args) {
   unsigned numArgs = args.size();
   (void) numArgs;
@@ -549,6 +596,26 @@ ref<Expr> ConcatExpr::create(const ref<Expr> &l, const ref<Expr> &r) {
     }
   }
 
+  // Merge with the head of a Concat chain, as built byte by byte by
+  // memory reads: C(E(x), C(E'(x), y)) and C(c, C(c', y)).
+  if (ConcatExpr *ce = dyn_cast<ConcatExpr>(r)) {
+    ref<Expr> head = ce->getLeft();
+    if (ExtractExpr *ee_left = dyn_cast<ExtractExpr>(l)) {
+      if (ExtractExpr *ee_right = dyn_cast<ExtractExpr>(head)) {
+        if (ee_left->expr == ee_right->expr &&
+            ee_right->offset + ee_right->width == ee_left->offset) {
+          return ConcatExpr::create(
+              ExtractExpr::create(ee_left->expr, ee_right->offset,
+                                  ee_left->width + ee_right->width),
+              ce->getRight());
+        }
+      }
+    } else if (ConstantExpr *lCE = dyn_cast<ConstantExpr>(l)) {
+      if (ConstantExpr *hCE = dyn_cast<ConstantExpr>(head))
+        return ConcatExpr::create(lCE->Concat(hCE), ce->getRight());
+    }
+  }
+
   return ConcatExpr::alloc(l, r);
 }
 
@@ -606,6 +673,11 @@ ref<Expr> ExtractExpr::create(ref<Expr> expr, unsigned off, Width w) {
             }
         } else
 
+        // E(E(x)) = E(x)
+        if (ExtractExpr *ee = dyn_cast<ExtractExpr>(expr)) {
+            return ExtractExpr::create(ee->expr, ee->offset + off, w);
+        } else
+
         // Extract(Concat)
         if (ConcatExpr *ce = dyn_cast<ConcatExpr>(expr)) {
 
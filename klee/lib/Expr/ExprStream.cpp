@@ -0,0 +1,301 @@
+//===-- ExprStream.cpp ----------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/util/ExprStream.h"
+
+#include "llvm/ADT/APInt.h"
+
+using namespace klee;
+
+/***/
+
+void ExprStreamWriter::writeVarint(uint64_t value) {
+  while (value >= 0x80) {
+    buffer.push_back((unsigned char) (value | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back((unsigned char) value);
+}
+
+void ExprStreamWriter::writeString(const std::string &s) {
+  writeVarint(s.size());
+  buffer.insert(buffer.end(), s.begin(), s.end());
+}
+
+unsigned ExprStreamWriter::writeArray(const Array *array) {
+  // Arrays are never freed, their address identifies them.
+  std::map<const Array*, unsigned>::iterator it = arrayIds.find(array);
+  if (it != arrayIds.end())
+    return it->second;
+
+  writeVarint(ExprStream::ArrayRecord);
+  writeString(array->name);
+  writeVarint(array->size);
+  writeVarint(array->constantValues.size());
+  for (unsigned i = 0; i < array->constantValues.size(); ++i)
+    writeVarint(array->constantValues[i]->getZExtValue(8));
+
+  unsigned id = arrayIds.size();
+  arrayIds.insert(std::make_pair(array, id));
+  return id;
+}
+
+/// Returns the id of un plus one, or 0 for the empty list. The nodes are
+/// kept alive by the read that refers to them, which write() records in
+/// exprIds, so their addresses are not reused until the next reset.
+unsigned ExprStreamWriter::writeUpdates(const Array *array,
+                                        const UpdateNode *un) {
+  // Walk back to the newest node already written, then define the
+  // remaining ones oldest first. Update lists can be long, so avoid
+  // recursing on them.
+  std::vector<const UpdateNode*> pending;
+  unsigned next = 0;
+  for (; un; un = un->next) {
+    std::map<const UpdateNode*, unsigned>::iterator it = updateIds.find(un);
+    if (it != updateIds.end()) {
+      next = it->second + 1;
+      break;
+    }
+    pending.push_back(un);
+  }
+
+  unsigned arrayId = writeArray(array);
+  for (std::vector<const UpdateNode*>::reverse_iterator it = pending.rbegin(),
+         ie = pending.rend(); it != ie; ++it) {
+    unsigned index = write((*it)->index);
+    unsigned value = write((*it)->value);
+
+    writeVarint(ExprStream::UpdateRecord);
+    writeVarint(arrayId);
+    writeVarint(next);
+    writeVarint(index);
+    writeVarint(value);
+
+    unsigned id = updateIds.size();
+    updateIds.insert(std::make_pair(*it, id));
+    next = id + 1;
+  }
+  return next;
+}
+
+unsigned ExprStreamWriter::write(const ref<Expr> &e) {
+  ExprHashMap<unsigned>::iterator it = exprIds.find(e);
+  if (it != exprIds.end())
+    return it->second;
+
+  // Operands are defined before the expression using them.
+  std::vector<uint64_t> fields;
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    const llvm::APInt &value = cast<ConstantExpr>(e)->getAPValue();
+    for (unsigned i = 0; i < value.getNumWords(); ++i)
+      fields.push_back(value.getRawData()[i]);
+    break;
+  }
+
+  case Expr::Read: {
+    const ReadExpr *re = cast<ReadExpr>(e);
+    fields.push_back(writeArray(re->updates.root));
+    fields.push_back(writeUpdates(re->updates.root, re->updates.head));
+    fields.push_back(write(re->index));
+    break;
+  }
+
+  case Expr::Extract:
+    fields.push_back(write(e->getKid(0)));
+    fields.push_back(cast<ExtractExpr>(e)->offset);
+    break;
+
+  default:
+    for (unsigned i = 0; i < e->getNumKids(); ++i)
+      fields.push_back(write(e->getKid(i)));
+    break;
+  }
+
+  writeVarint(ExprStream::ExprRecord);
+  writeVarint(e->getKind());
+  writeVarint(e->getWidth());
+  for (unsigned i = 0; i < fields.size(); ++i)
+    writeVarint(fields[i]);
+
+  unsigned id = exprIds.size();
+  exprIds.insert(std::make_pair(e, id));
+  return id;
+}
+
+void ExprStreamWriter::reset() {
+  writeVarint(ExprStream::ResetRecord);
+  exprIds.clear();
+  updateIds.clear();
+  arrayIds.clear();
+}
+
+/***/
+
+uint64_t ExprStreamReader::readVarint() {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos == end)
+      break;
+    unsigned char b = *pos++;
+    value |= (uint64_t) (b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return value;
+  }
+  error = true;
+  return 0;
+}
+
+std::string ExprStreamReader::readString() {
+  uint64_t size = readVarint();
+  if (size > (uint64_t) (end - pos)) {
+    error = true;
+    return std::string();
+  }
+  std::string res((const char*) pos, size);
+  pos += size;
+  return res;
+}
+
+bool ExprStreamReader::readArray() {
+  std::string name = readString();
+  uint64_t size = readVarint();
+  uint64_t numConstants = readVarint();
+  if (error || (numConstants && numConstants != size))
+    return false;
+
+  std::vector< ref<ConstantExpr> > constants;
+  for (uint64_t i = 0; i < numConstants && !error; ++i)
+    constants.push_back(ConstantExpr::create(readVarint() & 0xff, Expr::Int8));
+  if (error)
+    return false;
+
+  if (constants.empty())
+    arrays.push_back(new Array(name, size));
+  else
+    arrays.push_back(new Array(name, size, &constants[0],
+                               &constants[0] + constants.size()));
+  return true;
+}
+
+bool ExprStreamReader::readUpdate() {
+  uint64_t array = readVarint(), next = readVarint();
+  ref<Expr> index = getExpr(readVarint()), value = getExpr(readVarint());
+  if (error || array >= arrays.size() || next > updates.size() ||
+      index.isNull() || value.isNull() || value->getWidth() != Expr::Int8)
+    return false;
+
+  const UpdateNode *head = next ? updates[next - 1].head : 0;
+  UpdateList ul(arrays[array], head);
+  ul.extend(index, value);
+  updates.push_back(ul);
+  return true;
+}
+
+bool ExprStreamReader::readExpr() {
+  uint64_t kind = readVarint(), width = readVarint();
+  if (error || kind > Expr::LastKind || kind == Expr::NotOptimized + 1 ||
+      !width)
+    return false;
+
+  ref<Expr> res;
+  switch (kind) {
+  case Expr::Constant: {
+    std::vector<uint64_t> words;
+    for (unsigned i = 0; i < (width + 63) / 64; ++i)
+      words.push_back(readVarint());
+    if (error)
+      return false;
+    res = ConstantExpr::alloc(llvm::APInt(width, words.size(), &words[0]));
+    break;
+  }
+
+  case Expr::Read: {
+    uint64_t array = readVarint(), head = readVarint();
+    ref<Expr> index = getExpr(readVarint());
+    if (error || array >= arrays.size() || head > updates.size() ||
+        index.isNull())
+      return false;
+    const UpdateNode *un = head ? updates[head - 1].head : 0;
+    res = ReadExpr::create(UpdateList(arrays[array], un), index);
+    break;
+  }
+
+  case Expr::Extract: {
+    ref<Expr> kid = getExpr(readVarint());
+    uint64_t offset = readVarint();
+    if (error || kid.isNull() || offset + width > kid->getWidth())
+      return false;
+    res = ExtractExpr::create(kid, offset, width);
+    break;
+  }
+
+  case Expr::Not:
+  case Expr::NotOptimized: {
+    ref<Expr> kid = getExpr(readVarint());
+    if (error || kid.isNull())
+      return false;
+    if (kind == Expr::Not)
+      res = NotExpr::create(kid);
+    else
+      res = NotOptimizedExpr::create(kid);
+    break;
+  }
+
+  default: {
+    unsigned numKids = kind == Expr::Select ? 3 : 2;
+    if (kind == Expr::ZExt || kind == Expr::SExt)
+      numKids = 1;
+
+    std::vector<Expr::CreateArg> args;
+    for (unsigned i = 0; i < numKids; ++i) {
+      ref<Expr> kid = getExpr(readVarint());
+      if (error || kid.isNull())
+        return false;
+      args.push_back(kid);
+    }
+    if (numKids == 1)
+      args.push_back(Expr::CreateArg(width));
+    res = Expr::createFromKind((Expr::Kind) kind, args);
+    break;
+  }
+  }
+
+  exprs.push_back(res);
+  return true;
+}
+
+unsigned ExprStreamReader::nextRecord() {
+  while (!error && pos != end) {
+    uint64_t tag = readVarint();
+    switch (tag) {
+    case ExprStream::ArrayRecord:
+      error = !readArray();
+      break;
+    case ExprStream::UpdateRecord:
+      error = !readUpdate();
+      break;
+    case ExprStream::ExprRecord:
+      error = !readExpr();
+      break;
+    case ExprStream::ResetRecord:
+      exprs.clear();
+      updates.clear();
+      arrays.clear();
+      break;
+    default:
+      if (tag < ExprStream::FirstUserRecord) {
+        error = true;
+        break;
+      }
+      return tag;
+    }
+  }
+  return 0;
+}
@@ -27,7 +27,7 @@ UpdateNode::UpdateNode(const UpdateNode *_next,
          "Update value should be 8-bit wide.");
   computeHash();
   if (next) {
-    ++next->refCount;
+    refInc(next->refCount);
     size = 1 + next->size;
   }
   else size = 1;
@@ -59,20 +59,20 @@ unsigned UpdateNode::computeHash() {
 UpdateList::UpdateList(const Array *_root, const UpdateNode *_head)
   : root(_root),
     head(_head) {
-  if (head) ++head->refCount;
+  if (head) refInc(head->refCount);
 }
 
 UpdateList::UpdateList(const UpdateList &b)
   : root(b.root),
     head(b.head) {
-  if (head) ++head->refCount;
+  if (head) refInc(head->refCount);
 }
 
 UpdateList::~UpdateList() {
   // We need to be careful and avoid recursion here. We do this in
   // cooperation with the private dtor of UpdateNode which does not
   // recursively free its tail.
-  while (head && --head->refCount==0) {
+  while (head && refDec(head->refCount) == 0) {
     const UpdateNode *n = head->next;
     delete head;
     head = n;
@@ -80,17 +80,17 @@ UpdateList::~UpdateList() {
 }
 
 UpdateList &UpdateList::operator=(const UpdateList &b) {
-  if (b.head) ++b.head->refCount;
-  if (head && --head->refCount==0) delete head;
+  if (b.head) refInc(b.head->refCount);
+  if (head && refDec(head->refCount) == 0) delete head;
   root = b.root;
   head = b.head;
   return *this;
 }
 
 void UpdateList::extend(const ref<Expr> &index, const ref<Expr> &value) {
-  if (head) --head->refCount;
+  if (head) refDec(head->refCount);
   head = new UpdateNode(head, index, value);
-  ++head->refCount;
+  refInc(head->refCount);
 }
 
 int UpdateList::compare(const UpdateList &b) const {
@@ -190,6 +190,8 @@ InstructionInfoTable::InstructionInfoTable(Module *m)
       } while (!worklist.empty());
     }
   }
+
+  maxID = id;
 }
 
 InstructionInfoTable::~InstructionInfoTable() {
@@ -211,7 +213,7 @@ const std::string *InstructionInfoTable::internString(std::string s) {
 }
 
 unsigned InstructionInfoTable::getMaxID() const {
-  return infos.size();
+  return maxID;
 }
 
 const InstructionInfo &
@@ -233,3 +235,9 @@ InstructionInfoTable::getFunctionInfo(const Function *f) const {
     return getInfo(f->begin()->begin());
   }
 }
+
+void InstructionInfoTable::removeFunction(const Function *f) {
+  for (const_inst_iterator it = inst_begin(f), ie = inst_end(f);
+       it != ie; ++it)
+    infos.erase(&*it);
+}
@@ -22,6 +22,7 @@
 
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Instructions.h"
+#include "llvm/Linker.h"
 #if !(LLVM_VERSION_MAJOR == 2 && LLVM_VERSION_MINOR < 7)
 #include "llvm/LLVMContext.h"
 #include "llvm/Support/Path.h"
@@ -36,6 +37,9 @@
 #include "llvm/ValueSymbolTable.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/system_error.h"
+#include "llvm/ADT/OwningPtr.h"
 #if !(LLVM_VERSION_MAJOR == 2 && LLVM_VERSION_MINOR < 7)
 #include "llvm/Support/raw_os_ostream.h"
 #endif
@@ -43,6 +47,8 @@
 #include "llvm/Transforms/Scalar.h"
 
 #include <sstream>
+#include <cstdio>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -85,10 +91,21 @@ namespace {
   cl::opt<bool>
   DebugPrintEscapingFunctions("debug-print-escaping-functions", 
                               cl::desc("Print functions whose address is taken."));
+
+  cl::opt<std::string>
+  ModuleCacheDir("module-cache-dir",
+                 cl::desc("Directory where transformed modules are cached "
+                          "between runs (default=disabled)"),
+                 cl::init(""));
 }
 
+/// Bump when the transformations of KModule::transform change, to
+/// invalidate the modules cached by previous builds.
+#define KLEE_MODULE_CACHE_VERSION 1
+
 namespace llvm {
 extern void CreateOptimizePasses(PassManagerBase&, Module*);
+extern std::string GetOptimizePassesKey();
 }
 
 namespace klee {
@@ -275,55 +292,109 @@ static const char *index(const char *str, char c) {
 }
 #endif
 
-void KModule::prepare(const Interpreter::ModuleOptions &opts,
-                      InterpreterHandler *ih) {
-  if (!MergeAtExit.empty()) {
-    Function *mergeFn = module->getFunction("klee_merge");
-    if (!mergeFn) {
-      llvm::FunctionType *Ty =
-        FunctionType::get(Type::getVoidTy(getGlobalContext()), 
-                          ArrayRef<Type*>(std::vector<Type*>()), false);
-      mergeFn = Function::Create(Ty, GlobalVariable::ExternalLinkage,
-				 "klee_merge",
-				 module);
-    }
+static uint64_t hashBytes(const char *data, size_t size, uint64_t hash) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= (unsigned char) data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
 
-    for (cl::list<std::string>::iterator it = MergeAtExit.begin(), 
-           ie = MergeAtExit.end(); it != ie; ++it) {
-      std::string &name = *it;
-      Function *f = module->getFunction(name);
-      if (!f) {
-        klee_error("cannot insert merge-at-exit for: %s (cannot find)",
-                   name.c_str());
-      } else if (f->isDeclaration()) {
-        klee_error("cannot insert merge-at-exit for: %s (external)",
-                   name.c_str());
-      }
+static uint64_t hashString(const std::string &s, uint64_t hash) {
+  // Include the terminator so that consecutive strings stay distinct.
+  return hashBytes(s.c_str(), s.size() + 1, hash);
+}
 
-      BasicBlock *exit = BasicBlock::Create(getGlobalContext(), "exit", f);
-      PHINode *result = 0;
-      if (f->getReturnType() != Type::getVoidTy(getGlobalContext()))
-        result = PHINode::Create(f->getReturnType(), 0, "retval", exit);
-      CallInst::Create(mergeFn, "", exit);
-      ReturnInst::Create(getGlobalContext(), result, exit);
+/// A module can only be replaced by a cached one if it has no
+/// definitions of its own yet.
+static bool isEmptyModule(Module *module) {
+  for (Module::iterator it = module->begin(), ie = module->end();
+       it != ie; ++it)
+    if (!it->isDeclaration())
+      return false;
+  for (Module::global_iterator it = module->global_begin(),
+         ie = module->global_end(); it != ie; ++it)
+    if (!it->isDeclaration())
+      return false;
+  return true;
+}
 
-      llvm::errs() << "KLEE: adding klee_merge at exit of: " << name << "\n";
-      for (llvm::Function::iterator bbit = f->begin(), bbie = f->end(); 
-           bbit != bbie; ++bbit) {
-        if (&*bbit != exit) {
-          Instruction *i = bbit->getTerminator();
-          if (i->getOpcode()==Instruction::Ret) {
-            if (result) {
-              result->addIncoming(i->getOperand(0), bbit);
-            }
-            i->eraseFromParent();
-	    BranchInst::Create(exit, bbit);
-          }
-        }
-      }
+/// Return the cache file of the module that transform() would produce,
+/// or an empty string if a library cannot be read. The name depends on
+/// the contents of the libraries and on everything else that affects
+/// the transformations.
+std::string KModule::getCacheFileName(const Interpreter::ModuleOptions &opts) {
+  uint64_t hash = 14695981039346656037ULL;
+  std::stringstream key;
+  key << KLEE_MODULE_CACHE_VERSION << ' '
+      << LLVM_VERSION_MAJOR << '.' << LLVM_VERSION_MINOR << ' '
+      << opts.Optimize << opts.CheckDivZero << (opts.CustomPasses != 0) << ' '
+      << SwitchType << ' ' << GetOptimizePassesKey() << ' ' << opts.CacheTag;
+  hash = hashString(key.str(), hash);
+  hash = hashString(module->getTargetTriple(), hash);
+  hash = hashString(module->getDataLayout(), hash);
+
+  for (std::vector<std::string>::const_iterator it = opts.ExtraLibraries.begin(),
+         ie = opts.ExtraLibraries.end(); it != ie; ++it) {
+    OwningPtr<MemoryBuffer> buffer;
+    if (MemoryBuffer::getFile(*it, buffer))
+      return "";
+    hash = hashBytes(buffer->getBufferStart(), buffer->getBufferSize(), hash);
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "/module-%016llx.bc", (unsigned long long) hash);
+  return ModuleCacheDir + name;
+}
+
+/// Link a module cached by saveCachedModule into the (empty) module.
+bool KModule::loadCachedModule(const std::string &fileName) {
+  OwningPtr<MemoryBuffer> buffer;
+  if (MemoryBuffer::getFile(fileName, buffer))
+    return false;
+
+  std::string error;
+  Module *cached = ParseBitcodeFile(buffer.get(), module->getContext(), &error);
+  if (!cached) {
+    klee_warning("ignoring invalid cached module %s: %s",
+                 fileName.c_str(), error.c_str());
+    return false;
+  }
+
+  if (Linker::LinkModules(module, cached, Linker::DestroySource, &error)) {
+    klee_error("linking cached module %s failed: %s",
+               fileName.c_str(), error.c_str());
+  }
+  delete cached;
+
+  klee_message("loaded transformed module from %s", fileName.c_str());
+  return true;
+}
+
+/// Write the transformed module to the cache. Concurrent processes may
+/// write the same file, so it is written under a temporary name first.
+void KModule::saveCachedModule(const std::string &fileName) {
+  std::stringstream tmpName;
+  tmpName << fileName << '.' << getpid();
+
+  std::string error;
+  {
+    raw_fd_ostream os(tmpName.str().c_str(), error, raw_fd_ostream::F_Binary);
+    if (!error.empty()) {
+      klee_warning("unable to cache module in %s: %s",
+                   tmpName.str().c_str(), error.c_str());
+      return;
     }
+    WriteBitcodeToFile(module, os);
   }
 
+  if (rename(tmpName.str().c_str(), fileName.c_str()))
+    unlink(tmpName.str().c_str());
+}
+
+/// Link the libraries and run the passes that put the module in the form
+/// expected by the interpreter.
+void KModule::transform(const Interpreter::ModuleOptions &opts) {
   // Inject checks prior to optimization... we also perform the
   // invariant transformations that we will end up doing later so that
   // optimize is seeing what is as close as possible to the final
@@ -421,6 +492,66 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   if (f && f->use_empty()) f->eraseFromParent();
   f = module->getFunction("memset");
   if (f && f->use_empty()) f->eraseFromParent();
+}
+
+void KModule::prepare(const Interpreter::ModuleOptions &opts,
+                      InterpreterHandler *ih) {
+  if (!MergeAtExit.empty()) {
+    Function *mergeFn = module->getFunction("klee_merge");
+    if (!mergeFn) {
+      llvm::FunctionType *Ty =
+        FunctionType::get(Type::getVoidTy(getGlobalContext()), 
+                          ArrayRef<Type*>(std::vector<Type*>()), false);
+      mergeFn = Function::Create(Ty, GlobalVariable::ExternalLinkage,
+				 "klee_merge",
+				 module);
+    }
+
+    for (cl::list<std::string>::iterator it = MergeAtExit.begin(), 
+           ie = MergeAtExit.end(); it != ie; ++it) {
+      std::string &name = *it;
+      Function *f = module->getFunction(name);
+      if (!f) {
+        klee_error("cannot insert merge-at-exit for: %s (cannot find)",
+                   name.c_str());
+      } else if (f->isDeclaration()) {
+        klee_error("cannot insert merge-at-exit for: %s (external)",
+                   name.c_str());
+      }
+
+      BasicBlock *exit = BasicBlock::Create(getGlobalContext(), "exit", f);
+      PHINode *result = 0;
+      if (f->getReturnType() != Type::getVoidTy(getGlobalContext()))
+        result = PHINode::Create(f->getReturnType(), 0, "retval", exit);
+      CallInst::Create(mergeFn, "", exit);
+      ReturnInst::Create(getGlobalContext(), result, exit);
+
+      llvm::errs() << "KLEE: adding klee_merge at exit of: " << name << "\n";
+      for (llvm::Function::iterator bbit = f->begin(), bbie = f->end(); 
+           bbit != bbie; ++bbit) {
+        if (&*bbit != exit) {
+          Instruction *i = bbit->getTerminator();
+          if (i->getOpcode()==Instruction::Ret) {
+            if (result) {
+              result->addIncoming(i->getOperand(0), bbit);
+            }
+            i->eraseFromParent();
+	    BranchInst::Create(exit, bbit);
+          }
+        }
+      }
+    }
+  }
+
+  std::string cacheFile;
+  if (!ModuleCacheDir.empty() && MergeAtExit.empty() && isEmptyModule(module))
+    cacheFile = getCacheFileName(opts);
+
+  if (cacheFile.empty() || !loadCachedModule(cacheFile)) {
+    transform(opts);
+    if (!cacheFile.empty())
+      saveCachedModule(cacheFile);
+  }
 
 
   // Write out the .ll assembly file. We truncate long lines to work
@@ -582,13 +713,18 @@ KFunction* KModule::updateModuleWithFunction(llvm::Function *f)
 void KModule::removeFunction(llvm::Function *f, bool keepDeclaration)
 {
     std::map<llvm::Function*, KFunction*>::iterator it = functionMap.find(f);
-    assert(it != functionMap.end());
 
-    KFunction* kf = it->second;
-    functions.erase(std::find(functions.begin(), functions.end(), kf));
+    //The function may have been generated but never executed in KLEE,
+    //in which case there is no shadow structure for it.
+    if (it != functionMap.end()) {
+        KFunction* kf = it->second;
+        functions.erase(std::find(functions.begin(), functions.end(), kf));
+        functionMap.erase(it);
+        delete kf;
+    }
+
     escapingFunctions.erase(f);
-    functionMap.erase(f);
-    delete kf;
+    infos->removeFunction(f);
 
     if (keepDeclaration) {
         f->deleteBody();
@@ -29,6 +29,7 @@
 #include "llvm/Support/PassNameParser.h"
 #include "llvm/Support/PluginLoader.h"
 #include <iostream>
+#include <string>
 using namespace llvm;
 
 #if 0
@@ -279,4 +280,19 @@ void CreateOptimizePasses(PassManagerBase& Passes, Module* M) {
   //Passes.run(*M);
 }
 
+/// Describe the options that change the code produced by the passes of
+/// CreateOptimizePasses. Modules optimized with different descriptions
+/// must not share a cache entry. Options that only add verifier passes
+/// do not change the code and are left out. The explicit pass list is
+/// disabled above; it must be added here if it is enabled again.
+std::string GetOptimizePassesKey() {
+  std::string key;
+  key += DisableOptimizations ? 'O' : 'o';
+  key += DisableInline ? 'I' : 'i';
+  key += DisableInternalize ? 'N' : 'n';
+  key += Strip ? 'S' : 's';
+  key += StripDebug ? 'D' : 'd';
+  return key;
+}
+
 }
@@ -0,0 +1,300 @@
+//===-- main.cpp ----------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Rebuilds the execution tree from a path constraint log written by S2E's
+// ConstraintTracer and solves the negation of each branch whose other side
+// was not explored, writing the solutions as .ktest files.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+#include "klee/Solver.h"
+#include "klee/Internal/ADT/KTest.h"
+#include "klee/util/ExprStream.h"
+#include "klee/util/ExprUtil.h"
+
+#include "llvm/ADT/OwningPtr.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/system_error.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<std::string>
+  InputFile(cl::desc("<constraint log>"), cl::Positional, cl::Required);
+
+  cl::opt<std::string>
+  OutputDir("output-dir",
+            cl::desc("Directory for the .ktest files (default=.)"),
+            cl::init("."));
+
+  cl::opt<unsigned>
+  Jobs("jobs",
+       cl::desc("Number of processes solving the queries (default=1)"),
+       cl::init(1));
+
+  cl::opt<bool>
+  NegateConcretizations("negate-concretizations",
+                        cl::desc("Also solve for other values of the "
+                                 "concretized expressions"),
+                        cl::init(false));
+}
+
+namespace {
+  /// A constraint of the execution tree. The path constraints of a node
+  /// are the constraints of its ancestors.
+  struct PathNode {
+    PathNode *parent;
+    ref<Expr> constraint;
+    uint64_t pc;
+    uint32_t state;
+    bool branch;
+    std::vector<PathNode*> children;
+
+    PathNode(PathNode *_parent, ref<Expr> _constraint, uint64_t _pc,
+             uint32_t _state, bool _branch)
+      : parent(_parent), constraint(_constraint), pc(_pc), state(_state),
+        branch(_branch) {
+      if (parent)
+        parent->children.push_back(this);
+    }
+  };
+}
+
+/// A constraint sequence of the log and the state it belongs to.
+struct Sequence {
+  uint32_t state;
+  std::vector<PathNode*> path;
+};
+
+typedef std::map<uint64_t, Sequence> Sequences;
+
+static bool readLog(ExprStreamReader &reader, std::vector<PathNode*> &nodes) {
+  Sequences sequences;
+
+  while (unsigned tag = reader.nextRecord()) {
+    uint64_t id = reader.readVarint();
+
+    switch (tag) {
+    case ConstraintLog::StateRecord: {
+      // The state was not logged to this file before, or its constraints
+      // were replaced by a merge. They start a new branch of the tree.
+      Sequence &seq = sequences[id];
+      seq.state = reader.readVarint();
+      seq.path.clear();
+      uint64_t count = reader.readVarint();
+      for (uint64_t i = 0; i < count && !reader.hasError(); ++i) {
+        ref<Expr> e = reader.getExpr(reader.readVarint());
+        if (e.isNull())
+          return false;
+        nodes.push_back(new PathNode(seq.path.empty() ? 0 : seq.path.back(),
+                                     e, 0, seq.state, false));
+        seq.path.push_back(nodes.back());
+      }
+      break;
+    }
+
+    case ConstraintLog::ForkRecord: {
+      uint32_t state = reader.readVarint();
+      uint64_t parent = reader.readVarint();
+      uint64_t count = reader.readVarint();
+      Sequences::iterator it = sequences.find(parent);
+      if (it == sequences.end() || count > it->second.path.size())
+        return false;
+      Sequence &seq = sequences[id];
+      seq.state = state;
+      seq.path.assign(it->second.path.begin(),
+                      it->second.path.begin() + count);
+      break;
+    }
+
+    case ConstraintLog::ConstraintRecord: {
+      uint64_t pc = reader.readVarint();
+      uint64_t flags = reader.readVarint();
+      ref<Expr> e = reader.getExpr(reader.readVarint());
+      Sequences::iterator it = sequences.find(id);
+      if (e.isNull() || it == sequences.end())
+        return false;
+      Sequence &seq = it->second;
+      nodes.push_back(new PathNode(seq.path.empty() ? 0 : seq.path.back(),
+                                   e, pc, seq.state,
+                                   flags & ConstraintLog::BranchFlag));
+      seq.path.push_back(nodes.back());
+      break;
+    }
+
+    case ConstraintLog::KillRecord:
+      // The sequence is kept: a speculative child of the state only logs
+      // its ForkRecord when it is resolved, possibly after the parent died.
+      break;
+
+    default:
+      std::cerr << "klee-solve-log: unknown record " << tag << "\n";
+      return false;
+    }
+  }
+
+  return !reader.hasError();
+}
+
+/// The other side of a branch is known if a sibling in the tree took it.
+static bool isExplored(const PathNode *node) {
+  if (!node->parent)
+    return false;
+  ref<Expr> negation = Expr::createIsZero(node->constraint);
+  for (unsigned i = 0; i < node->parent->children.size(); ++i) {
+    const PathNode *sibling = node->parent->children[i];
+    if (sibling->constraint == negation ||
+        Expr::createIsZero(sibling->constraint) == node->constraint)
+      return true;
+  }
+  return false;
+}
+
+static void writeTest(const std::string &path,
+                      const std::vector<const Array*> &objects,
+                      std::vector< std::vector<unsigned char> > &values) {
+  KTest b;
+  b.numArgs = 0;
+  b.args = 0;
+  b.symArgvs = 0;
+  b.symArgvLen = 0;
+  b.numObjects = objects.size();
+  b.objects = new KTestObject[b.numObjects];
+  for (unsigned i = 0; i < b.numObjects; i++) {
+    KTestObject *o = &b.objects[i];
+    o->name = const_cast<char*>(objects[i]->name.c_str());
+    o->numBytes = values[i].size();
+    o->bytes = values[i].empty() ? 0 : &values[i][0];
+  }
+
+  if (!kTest_toFile(&b, path.c_str()))
+    std::cerr << "klee-solve-log: unable to write " << path << "\n";
+
+  delete[] b.objects;
+}
+
+static void solveQueries(const std::vector<PathNode*> &queries,
+                         unsigned first, unsigned step) {
+  Solver *solver = new STPSolver(false);
+  solver = createCexCachingSolver(solver);
+  solver = createCachingSolver(solver);
+  solver = createIndependentSolver(solver);
+
+  for (unsigned i = first; i < queries.size(); i += step) {
+    const PathNode *node = queries[i];
+
+    std::vector< ref<Expr> > prefix;
+    for (const PathNode *n = node->parent; n; n = n->parent)
+      prefix.push_back(n->constraint);
+    std::reverse(prefix.begin(), prefix.end());
+
+    std::vector<const Array*> objects;
+    std::vector< ref<Expr> > all(prefix);
+    all.push_back(node->constraint);
+    findSymbolicObjects(all.begin(), all.end(), objects);
+
+    // Solutions of the prefix that violate the constraint
+    ConstraintManager constraints(prefix);
+    std::vector< std::vector<unsigned char> > values;
+    bool solved = solver->getInitialValues(Query(constraints, node->constraint),
+                                           objects, values);
+
+    std::stringstream ss;
+    ss << "query " << i << ": state " << node->state
+       << " depth " << prefix.size()
+       << " pc 0x" << std::hex << node->pc << std::dec;
+    if (solved) {
+      std::stringstream name;
+      name << OutputDir << "/query" << std::setw(6) << std::setfill('0')
+           << i << ".ktest";
+      writeTest(name.str(), objects, values);
+      ss << ": " << name.str() << "\n";
+    } else {
+      ss << ": no solution\n";
+    }
+    std::cout << ss.str() << std::flush;
+  }
+
+  delete solver;
+}
+
+int main(int argc, char **argv) {
+  llvm::sys::PrintStackTraceOnErrorSignal();
+  llvm::cl::ParseCommandLineOptions(argc, argv);
+
+  llvm::error_code ErrorStr;
+  llvm::OwningPtr<MemoryBuffer> MB;
+  if ((ErrorStr = MemoryBuffer::getFile(InputFile, MB))) {
+    std::cerr << argv[0] << ": error: " << ErrorStr.message() << "\n";
+    return 1;
+  }
+
+  const unsigned char *begin = (const unsigned char*) MB->getBufferStart();
+  ExprStreamReader reader(begin, begin + MB->getBufferSize());
+  std::vector<PathNode*> nodes;
+  if (!readLog(reader, nodes)) {
+    // A log cut by a crash still has its complete records
+    std::cerr << argv[0] << ": warning: malformed or truncated log\n";
+  }
+
+  // Constraints listed by a StateRecord have no pc and are not negated
+  std::vector<PathNode*> queries;
+  for (unsigned i = 0; i < nodes.size(); ++i) {
+    PathNode *node = nodes[i];
+    if ((node->branch || NegateConcretizations) && node->pc &&
+        !isExplored(node))
+      queries.push_back(node);
+  }
+  std::cout << nodes.size() << " constraints, "
+            << queries.size() << " queries\n" << std::flush;
+
+  unsigned jobs = std::max(1U, (unsigned) Jobs);
+  if (jobs == 1) {
+    solveQueries(queries, 0, 1);
+  } else {
+    std::vector<pid_t> workers;
+    for (unsigned i = 0; i < jobs; ++i) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        solveQueries(queries, i, jobs);
+        _exit(0);
+      } else if (pid > 0) {
+        workers.push_back(pid);
+      } else {
+        std::cerr << argv[0] << ": warning: could not fork worker " << i
+                  << ", solving its queries here\n";
+        solveQueries(queries, i, jobs);
+      }
+    }
+    for (unsigned i = 0; i < workers.size(); ++i)
+      waitpid(workers[i], NULL, 0);
+  }
+
+  for (unsigned i = 0; i < nodes.size(); ++i)
+    delete nodes[i];
+
+  llvm::llvm_shutdown();
+  return 0;
+}
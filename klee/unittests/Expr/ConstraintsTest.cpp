@@ -0,0 +1,54 @@
+//===-- ConstraintsTest.cpp -----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Constraints.h"
+#include "klee/Expr.h"
+
+using namespace klee;
+
+namespace {
+
+TEST(ConstraintsTest, SimplifyWithEqualities) {
+  Array *array = new Array("constraints_arr", 8);
+  ref<Expr> x = Expr::createTempRead(array, 32);
+  ref<Expr> y = AddExpr::create(x, ConstantExpr::create(1, Expr::Int32));
+  ref<Expr> z = Expr::createTempRead(new Array("constraints_arr2", 4), 8);
+  ref<ConstantExpr> five = ConstantExpr::create(5, Expr::Int32);
+
+  ConstraintManager cm;
+  ref<Expr> lt = UltExpr::create(z, ConstantExpr::create(10, Expr::Int8));
+  cm.addConstraint(lt);
+  EXPECT_TRUE(cm.simplifyExpr(lt)->isTrue());
+  EXPECT_EQ(x, cm.simplifyExpr(x));
+
+  // Constraints added after the index was built are applied
+  cm.addConstraint(EqExpr::create(five, x));
+  EXPECT_EQ(ref<Expr>(five), cm.simplifyExpr(x));
+  EXPECT_EQ(ref<Expr>(ConstantExpr::create(6, Expr::Int32)),
+            cm.simplifyExpr(y));
+
+  // Implied equalities simplify without becoming constraints, and are
+  // kept by copies
+  size_t size = cm.size();
+  cm.addImpliedEquality(z, ConstantExpr::create(3, Expr::Int8));
+  EXPECT_EQ(size, cm.size());
+  ConstraintManager copy(cm);
+  EXPECT_EQ(ref<Expr>(ConstantExpr::create(3, Expr::Int8)),
+            copy.simplifyExpr(z));
+
+  // The index is rebuilt from a list of constraints on demand
+  std::vector< ref<Expr> > list(cm.begin(), cm.end());
+  ConstraintManager fromList(list);
+  EXPECT_EQ(ref<Expr>(five), fromList.simplifyExpr(x));
+  EXPECT_EQ(z, fromList.simplifyExpr(z));
+}
+
+}
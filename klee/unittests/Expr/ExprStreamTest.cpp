@@ -0,0 +1,143 @@
+//===-- ExprStreamTest.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+#include "klee/util/ExprStream.h"
+
+#include "llvm/ADT/APInt.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+enum { ConstraintRecord = ExprStream::FirstUserRecord };
+
+TEST(ExprStreamTest, RoundTrip) {
+  Array *array = new Array("stream_arr", 16);
+  ref<ConstantExpr> values[4] = { ConstantExpr::create(1, Expr::Int8),
+                                  ConstantExpr::create(2, Expr::Int8),
+                                  ConstantExpr::create(3, Expr::Int8),
+                                  ConstantExpr::create(4, Expr::Int8) };
+  Array *constArray = new Array("stream_const", 4, values, values + 4);
+
+  ref<Expr> read32 = Expr::createTempRead(array, 32);
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::create(0, Expr::Int32),
+            ExtractExpr::create(read32, 8, 8));
+  ref<Expr> updated = ReadExpr::create(ul, ZExtExpr::create(
+      ReadExpr::create(UpdateList(constArray, 0), read32), Expr::Int32));
+  uint64_t words[2] = { 1, 2 };
+  ref<Expr> wide = ConstantExpr::alloc(llvm::APInt(128, 2, words));
+
+  std::vector< ref<Expr> > exprs;
+  exprs.push_back(UltExpr::create(read32, ConstantExpr::create(100, 32)));
+  exprs.push_back(EqExpr::create(ZExtExpr::create(updated, 32), read32));
+  exprs.push_back(SelectExpr::create(exprs[0], read32,
+                                     ConstantExpr::create(0, 32)));
+  exprs.push_back(UltExpr::create(ZExtExpr::create(read32, 128), wide));
+  exprs.push_back(NotExpr::create(read32));
+
+  ExprStreamWriter writer;
+  for (unsigned i = 0; i < exprs.size(); ++i) {
+    unsigned id = writer.write(exprs[i]);
+    writer.writeVarint(ConstraintRecord);
+    writer.writeVarint(id);
+  }
+
+  // The shared read is defined once, later uses only cost an id.
+  size_t size = writer.getBuffer().size();
+  EXPECT_EQ(writer.write(exprs[1]), writer.write(exprs[1]));
+  writer.writeVarint(ConstraintRecord);
+  writer.writeVarint(writer.write(exprs[1]));
+  EXPECT_EQ(size + 2, writer.getBuffer().size());
+
+  std::vector<unsigned char> buffer = writer.getBuffer();
+  ExprStreamReader reader(&buffer[0], &buffer[0] + buffer.size());
+  ExprStreamWriter rewriter;
+  for (unsigned i = 0; i < exprs.size(); ++i) {
+    ASSERT_EQ((unsigned) ConstraintRecord, reader.nextRecord());
+    ref<Expr> e = reader.getExpr(reader.readVarint());
+    ASSERT_FALSE(e.isNull());
+    EXPECT_EQ(exprs[i]->getKind(), e->getKind());
+    EXPECT_EQ(exprs[i]->getWidth(), e->getWidth());
+    // The arrays are new objects, compare the serialized forms.
+    ExprStreamWriter a, b;
+    a.write(exprs[i]);
+    b.write(e);
+    EXPECT_EQ(a.getBuffer(), b.getBuffer());
+  }
+  ASSERT_EQ((unsigned) ConstraintRecord, reader.nextRecord());
+  EXPECT_EQ(reader.getExpr(1), reader.getExpr(1));
+  reader.readVarint();
+  EXPECT_EQ(0U, reader.nextRecord());
+  EXPECT_FALSE(reader.hasError());
+}
+
+TEST(ExprStreamTest, Reset) {
+  Array *array = new Array("stream_arr2", 4);
+  ref<Expr> read = Expr::createTempRead(array, 8);
+
+  ExprStreamWriter writer;
+  unsigned id = writer.write(read);
+  writer.reset();
+  EXPECT_EQ(0U, writer.getNumExprs());
+  EXPECT_EQ(id, writer.write(read));
+  writer.writeVarint(ConstraintRecord);
+  writer.writeVarint(id);
+
+  std::vector<unsigned char> buffer = writer.getBuffer();
+  ExprStreamReader reader(&buffer[0], &buffer[0] + buffer.size());
+  ASSERT_EQ((unsigned) ConstraintRecord, reader.nextRecord());
+  ref<Expr> e = reader.getExpr(reader.readVarint());
+  ASSERT_FALSE(e.isNull());
+  EXPECT_EQ(Expr::Read, e->getKind());
+  EXPECT_TRUE(reader.getExpr(id + 1).isNull());
+
+  // Truncated streams are reported as errors.
+  ExprStreamReader truncated(&buffer[0], &buffer[0] + buffer.size() - 3);
+  EXPECT_EQ(0U, truncated.nextRecord());
+  EXPECT_TRUE(truncated.hasError());
+}
+
+TEST(ExprStreamTest, Arrays) {
+  Array *array = new Array("stream_arr3", 8);
+  ref<Expr> read = Expr::createTempRead(array, 8);
+
+  // An array referred to by a record does not need to appear in any
+  // expression, and expressions reuse its definition.
+  ExprStreamWriter writer;
+  unsigned arrayId = writer.write(array);
+  writer.writeVarint(ConstraintRecord);
+  writer.writeVarint(arrayId);
+  unsigned id = writer.write(read);
+  writer.writeVarint(ConstraintRecord);
+  writer.writeVarint(id);
+  EXPECT_EQ(arrayId, writer.write(array));
+
+  std::vector<unsigned char> buffer = writer.getBuffer();
+  ExprStreamReader reader(&buffer[0], &buffer[0] + buffer.size());
+  ASSERT_EQ((unsigned) ConstraintRecord, reader.nextRecord());
+  const Array *a = reader.getArray(reader.readVarint());
+  ASSERT_TRUE(a != 0);
+  EXPECT_EQ("stream_arr3", a->name);
+  EXPECT_EQ(8U, a->size);
+  EXPECT_TRUE(reader.getArray(arrayId + 1) == 0);
+
+  ASSERT_EQ((unsigned) ConstraintRecord, reader.nextRecord());
+  ref<Expr> e = reader.getExpr(reader.readVarint());
+  ASSERT_FALSE(e.isNull());
+  EXPECT_EQ(a, cast<ReadExpr>(e)->updates.root);
+  EXPECT_FALSE(reader.hasError());
+}
+
+}
@@ -7,11 +7,18 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <climits>
+#include <ctime>
 #include <iostream>
+#include <vector>
 #include "gtest/gtest.h"
 
 #include "klee/Expr.h"
 
+#ifdef KLEE_THREADSAFE_REFS
+#include <pthread.h>
+#endif
+
 using namespace klee;
 
 namespace {
@@ -110,4 +117,140 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, ReferenceCounts) {
+  Array *array = new Array("arr", 256);
+  ref<Expr> read = Expr::createTempRead(array, 8);
+  EXPECT_EQ(1U, read->refCount);
+  {
+    std::vector<ref<Expr> > copies(100, read);
+    EXPECT_EQ(101U, read->refCount);
+  }
+  EXPECT_EQ(1U, read->refCount);
+}
+
+#ifdef KLEE_THREADSAFE_REFS
+void *copyReferences(void *arg) {
+  const ref<Expr> &e = *static_cast<const ref<Expr>*>(arg);
+  for (unsigned i = 0; i < 1000000; ++i) {
+    ref<Expr> copy = e;
+  }
+  return 0;
+}
+
+TEST(ExprTest, ThreadSafeReferenceCounts) {
+  Array *array = new Array("arr", 256);
+  ref<Expr> read = Expr::createTempRead(array, 8);
+
+  pthread_t threads[4];
+  for (unsigned i = 0; i < 4; ++i)
+    pthread_create(&threads[i], 0, copyReferences, &read);
+  for (unsigned i = 0; i < 4; ++i)
+    pthread_join(threads[i], 0);
+
+  EXPECT_EQ(1U, read->refCount);
+}
+#endif
+
+TEST(ExprTest, ByteChains) {
+  Array *array = new Array("arr4", 256);
+  ref<Expr> read32 = Expr::createTempRead(array, 32);
+  Array *array2 = new Array("arr5", 256);
+  ref<Expr> read8 = Expr::createTempRead(array2, 8);
+
+  // Extract of Extract
+  ref<Expr> extract1 = ExtractExpr::create(
+      ExtractExpr::create(AddExpr::create(read32, read32), 8, 16), 4, 8);
+  EXPECT_EQ(Expr::Extract, extract1->getKind());
+  EXPECT_EQ(12U, cast<ExtractExpr>(extract1)->offset);
+  EXPECT_EQ(Expr::Add, extract1->getKid(0)->getKind());
+
+  // Bytes of a value followed by another byte, concatenated the way
+  // memory reads do.
+  ref<Expr> sum = AddExpr::create(read32, read32);
+  ref<Expr> kids1[4] = { ExtractExpr::create(sum, 16, 8),
+                         ExtractExpr::create(sum, 8, 8),
+                         ExtractExpr::create(sum, 0, 8),
+                         read8 };
+  ref<Expr> concat1 = ConcatExpr::createN(4, kids1);
+  EXPECT_EQ(Expr::Concat, concat1->getKind());
+  EXPECT_EQ(ExtractExpr::create(sum, 0, 24), concat1->getKid(0));
+  EXPECT_EQ(read8, concat1->getKid(1));
+
+  ref<Expr> kids2[3] = { getConstant(1, 8), getConstant(2, 8), read8 };
+  ref<Expr> concat2 = ConcatExpr::createN(3, kids2);
+  EXPECT_EQ(getConstant(0x102, 16), concat2->getKid(0));
+  EXPECT_EQ(read8, concat2->getKid(1));
+}
+
+TEST(ExprTest, SizeAndDepth) {
+  Array *array = new Array("arr", 256);
+  ref<Expr> c = ConstantExpr::alloc(0, 8);
+  EXPECT_EQ(1U, c->getTreeSize());
+  EXPECT_EQ(1U, c->computeDagSize());
+  EXPECT_EQ(0U, c->getDepth());
+
+  // A read counts its index and the updates of its array.
+  ref<Expr> read = ReadExpr::alloc(UpdateList(array, 0),
+                                   ConstantExpr::alloc(1, Expr::Int32));
+  EXPECT_EQ(2U, read->getTreeSize());
+  EXPECT_EQ(2U, read->computeDagSize());
+  EXPECT_EQ(1U, read->getDepth());
+
+  UpdateList ul(array, 0);
+  ul.extend(ConstantExpr::alloc(0, Expr::Int32), c);
+  ul.extend(ConstantExpr::alloc(1, Expr::Int32), c);
+  ref<Expr> read2 = ReadExpr::alloc(ul, ConstantExpr::alloc(2, Expr::Int32));
+  EXPECT_EQ(4U, read2->getTreeSize());
+  EXPECT_EQ(4U, read2->computeDagSize());
+
+  // Shared subexpressions are counted once in the DAG size, and once per
+  // occurrence in the tree size.
+  ref<Expr> add = AddExpr::alloc(read, read);
+  EXPECT_EQ(5U, add->getTreeSize());
+  EXPECT_EQ(3U, add->computeDagSize());
+  EXPECT_EQ(2U, add->getDepth());
+  ref<Expr> add2 = AddExpr::alloc(add, add);
+  EXPECT_EQ(11U, add2->getTreeSize());
+  EXPECT_EQ(4U, add2->computeDagSize());
+  EXPECT_EQ(3U, add2->getDepth());
+  ref<Expr> ext = ZExtExpr::alloc(add2, Expr::Int32);
+  EXPECT_EQ(12U, ext->getTreeSize());
+  EXPECT_EQ(5U, ext->computeDagSize());
+  EXPECT_EQ(4U, ext->getDepth());
+
+  // Reads sharing updates count them once.
+  ref<Expr> sum = AddExpr::alloc(
+      read2, ReadExpr::alloc(ul, ConstantExpr::alloc(3, Expr::Int32)));
+  EXPECT_EQ(7U, sum->computeDagSize());
+
+  // A chain of x = x ^ (x << 1) doubles the tree size at each step, but
+  // only adds three nodes to the DAG.
+  ref<Expr> x = read;
+  for (unsigned i = 0; i < 40; ++i)
+    x = XorExpr::alloc(x, ShlExpr::alloc(x, ConstantExpr::alloc(1, Expr::Int8)));
+  EXPECT_EQ(UINT_MAX, x->getTreeSize());
+  EXPECT_EQ(2U + 3 * 40, x->computeDagSize());
+  EXPECT_GT(x->computeDagSize(10), 10U);
+  EXPECT_GE(12U, x->computeDagSize(10));
+}
+
+// Compare the cost of reference counting in builds with and without
+// THREADSAFE_REFS. Run with --gtest_also_run_disabled_tests.
+TEST(ExprTest, DISABLED_BenchmarkReferenceCounts) {
+  Array *array = new Array("arr", 256);
+  ref<Expr> read = Expr::createTempRead(array, 32);
+  std::vector<ref<Expr> > copies(1024);
+
+  clock_t start = clock();
+  for (unsigned round = 0; round < 20000; ++round) {
+    for (unsigned i = 0; i < copies.size(); ++i)
+      copies[i] = read;
+    for (unsigned i = 0; i < copies.size(); ++i)
+      copies[i] = ref<Expr>();
+  }
+  std::cout << "ref<Expr> updates: "
+            << double(clock() - start) / CLOCKS_PER_SEC << "s\n";
+  EXPECT_EQ(1U, read->refCount);
+}
+
 }
@@ -0,0 +1,89 @@
+//===-- FlagsExprTest.cpp -------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Expr.h"
+
+// The eflags builders used by the lazy flags helper handlers of S2E
+#include "klee/util/FlagsExpr.h"
+
+using namespace klee;
+
+namespace {
+
+// QEMU's compute_all_{add,sub,logic}b for 8-bit operands
+unsigned referenceFlags(FlagsOpKind kind, uint8_t dst, uint8_t src) {
+  uint8_t src1 = 0, src2 = 0;
+  unsigned cf = 0, af = 0, of = 0;
+  switch (kind) {
+  case FLAGS_OP_ADD:
+    src1 = src;
+    src2 = dst - src;
+    cf = dst < src1;
+    break;
+  case FLAGS_OP_SUB:
+    src1 = dst + src;
+    src2 = src;
+    cf = src1 < src2;
+    break;
+  default:
+    break;
+  }
+
+  unsigned bits = 0;
+  for (uint8_t b = dst; b; b >>= 1)
+    bits += b & 1;
+  unsigned pf = (bits % 2) ? 0 : 0x04;
+
+  if (kind != FLAGS_OP_LOGIC) {
+    af = (dst ^ src1 ^ src2) & 0x10;
+    uint8_t x = src1 ^ src2;
+    if (kind == FLAGS_OP_ADD)
+      x = ~x;
+    of = ((x & (src1 ^ dst)) & 0x80) << 4;
+  }
+
+  unsigned zf = dst == 0 ? 0x40 : 0;
+  unsigned sf = dst & 0x80;
+  return cf | pf | af | zf | sf | of;
+}
+
+TEST(FlagsExprTest, MatchesHelpers) {
+  FlagsOpKind kinds[3] = { FLAGS_OP_ADD, FLAGS_OP_SUB, FLAGS_OP_LOGIC };
+  for (unsigned k = 0; k < 3; ++k) {
+    for (unsigned dst = 0; dst < 256; ++dst) {
+      for (unsigned src = 0; src < 256; ++src) {
+        // CC_DST and CC_SRC are target-width registers
+        FlagsOperands ops =
+          getFlagsOperands(kinds[k], ConstantExpr::create(dst | 0x100, 32),
+                           ConstantExpr::create(src, 32), Expr::Int8);
+        ref<Expr> flags = computeAllFlags(kinds[k], ops);
+        ASSERT_TRUE(isa<ConstantExpr>(flags));
+        ASSERT_EQ(referenceFlags(kinds[k], dst, src),
+                  cast<ConstantExpr>(flags)->getZExtValue())
+          << "kind " << k << " dst " << dst << " src " << src;
+      }
+    }
+  }
+}
+
+TEST(FlagsExprTest, SymbolicSubCarry) {
+  Array *array = new Array("flags_arr", 8);
+  ref<Expr> a = Expr::createTempRead(array, 32);
+  ref<Expr> b = ZExtExpr::create(Expr::createTempRead(array, 8), 32);
+
+  // cmp a, b leaves CC_DST = a - b and CC_SRC = b
+  FlagsOperands ops = getFlagsOperands(FLAGS_OP_SUB, SubExpr::create(a, b),
+                                       b, Expr::Int32);
+  EXPECT_EQ(a, ops.src1);
+  EXPECT_EQ(UltExpr::create(a, b), computeCarry(FLAGS_OP_SUB, ops));
+}
+
+}
@@ -0,0 +1,55 @@
+//===-- PathHashTest.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/util/PathHash.h"
+
+using namespace klee;
+
+namespace {
+
+uint64_t follow(const uint64_t *pcs, const unsigned *directions, unsigned n) {
+  uint64_t hash = 0;
+  for (unsigned i = 0; i < n; ++i)
+    hash = forkPathHash(hash, pcs[i], directions[i]);
+  return hash;
+}
+
+TEST(PathHashTest, FNV1a) {
+  // Bytes of 0x80ff in little-endian order, high bytes are not sign-extended
+  EXPECT_EQ(0x395476bfcd33109aULL, hash64(0x80ff));
+}
+
+TEST(PathHashTest, SamePathSameHash) {
+  uint64_t pcs[3] = { 0x401000, 0xffffffff81000000ULL, 0x401000 };
+  unsigned path[3] = { 0, 1, 3 };
+  unsigned other[3] = { 0, 1, 3 };
+
+  EXPECT_EQ(follow(pcs, path, 3), follow(pcs, other, 3));
+  EXPECT_EQ(follow(pcs, path, 2), follow(pcs, other, 2));
+}
+
+TEST(PathHashTest, DifferentPathsDiffer) {
+  uint64_t pcs[3] = { 0x401000, 0x401010, 0x401000 };
+  unsigned path[3] = { 0, 1, 0 };
+  unsigned flipped[3] = { 0, 0, 0 };
+  unsigned swapped[3] = { 1, 0, 0 };
+
+  uint64_t hash = follow(pcs, path, 3);
+  EXPECT_NE(hash, follow(pcs, flipped, 3));
+  EXPECT_NE(hash, follow(pcs, swapped, 3));
+  EXPECT_NE(hash, follow(pcs, path, 2));
+
+  // Same decisions at different branches
+  uint64_t otherPcs[3] = { 0x401000, 0x401020, 0x401000 };
+  EXPECT_NE(hash, follow(otherPcs, path, 3));
+}
+
+}
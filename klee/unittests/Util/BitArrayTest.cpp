@@ -0,0 +1,98 @@
+//===-- BitArrayTest.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/util/BitArray.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+TEST(BitArrayTest, WordBoundaries) {
+  BitArray b(128, false);
+  EXPECT_TRUE(b.isAllZeros(128));
+  EXPECT_FALSE(b.isAllOnes(128));
+
+  b.setRange(30, 40);
+  EXPECT_TRUE(b.isAllOnes(30, 40));
+  EXPECT_FALSE(b.isAllOnes(29, 41));
+  EXPECT_FALSE(b.isAllOnes(30, 41));
+  EXPECT_TRUE(b.isAllZeros(0, 30));
+  EXPECT_TRUE(b.isAllZeros(70, 58));
+  EXPECT_TRUE(b.isAnyOne(0, 31));
+  EXPECT_EQ(40U, b.count(128));
+
+  EXPECT_EQ(30U, b.findFirstSet(0, 128));
+  EXPECT_EQ(0U, b.findFirstUnset(0, 128));
+  EXPECT_EQ(70U, b.findFirstUnset(30, 128));
+  EXPECT_EQ(50U, b.findFirstUnset(30, 50));
+
+  b.unsetRange(32, 32);
+  EXPECT_EQ(8U, b.count(128));
+  EXPECT_EQ(64U, b.findFirstSet(32, 128));
+}
+
+TEST(BitArrayTest, FullWords) {
+  BitArray b(4096, true);
+  EXPECT_TRUE(b.isAllOnes(4096));
+  b.unset(4095);
+  EXPECT_FALSE(b.isAllOnes(4096));
+  EXPECT_TRUE(b.isAllOnes(4095));
+  EXPECT_EQ(4095U, b.findFirstUnset(0, 4096));
+  EXPECT_EQ(4095U, b.count(4096));
+}
+
+TEST(BitArrayTest, MatchesPerBitOperations) {
+  const unsigned size = 300;
+  BitArray b(size, false);
+  std::vector<bool> ref(size, false);
+
+  unsigned seed = 1;
+  for (unsigned it = 0; it < 1000; ++it) {
+    seed = seed * 1103515245 + 12345;
+    unsigned begin = (seed >> 8) % size;
+    seed = seed * 1103515245 + 12345;
+    unsigned count = (seed >> 8) % (size - begin + 1);
+    bool value = (seed >> 4) & 1;
+
+    if (value)
+      b.setRange(begin, count);
+    else
+      b.unsetRange(begin, count);
+    for (unsigned i = begin; i < begin + count; ++i)
+      ref[i] = value;
+
+    unsigned lo = begin / 2, hi = begin + count;
+    unsigned fs = hi, fu = hi;
+    for (unsigned i = hi; i > lo; --i) {
+      if (ref[i - 1])
+        fs = i - 1;
+      else
+        fu = i - 1;
+    }
+    EXPECT_EQ(fs, b.findFirstSet(lo, hi));
+    EXPECT_EQ(fu, b.findFirstUnset(lo, hi));
+    if (value)
+      EXPECT_TRUE(b.isAllOnes(begin, count));
+    else
+      EXPECT_TRUE(b.isAllZeros(begin, count));
+  }
+
+  unsigned total = 0;
+  for (unsigned i = 0; i < size; ++i) {
+    EXPECT_EQ((bool) ref[i], b.get(i));
+    total += ref[i];
+  }
+  EXPECT_EQ(total, b.count(size));
+}
+
+}
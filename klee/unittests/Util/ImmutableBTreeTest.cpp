@@ -0,0 +1,184 @@
+//===-- ImmutableBTreeTest.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/ImmutableBTree.h"
+#include "klee/Internal/ADT/ImmutableMap.h"
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef ImmutableMap<unsigned, unsigned, std::less<unsigned>,
+                     ImmutableBTree> BTreeMap;
+typedef ImmutableMap<unsigned, unsigned> AVLMap;
+typedef std::map<unsigned, unsigned> RefMap;
+
+void checkEqual(const BTreeMap &m, const RefMap &ref) {
+  ASSERT_EQ(ref.size(), m.size());
+  ASSERT_EQ(ref.empty(), m.empty());
+
+  RefMap::const_iterator ri = ref.begin();
+  for (BTreeMap::iterator it = m.begin(), ie = m.end(); it != ie; ++it, ++ri) {
+    ASSERT_TRUE(ri != ref.end());
+    EXPECT_EQ(ri->first, it->first);
+    EXPECT_EQ(ri->second, it->second);
+  }
+  EXPECT_TRUE(ri == ref.end());
+
+  // Walk backwards from end().
+  RefMap::const_reverse_iterator rri = ref.rbegin();
+  BTreeMap::iterator it = m.end();
+  for (size_t i = 0; i < ref.size(); ++i, ++rri) {
+    --it;
+    EXPECT_EQ(rri->first, it->first);
+  }
+  if (!ref.empty()) {
+    EXPECT_EQ(ref.begin()->first, m.min().first);
+    EXPECT_EQ(ref.rbegin()->first, m.max().first);
+  }
+}
+
+TEST(ImmutableBTreeTest, RandomOperations) {
+  srand(1);
+  BTreeMap m;
+  RefMap ref;
+  std::vector<BTreeMap> versions;
+  std::vector<RefMap> refVersions;
+
+  for (unsigned i = 0; i < 20000; ++i) {
+    unsigned key = rand() % 4096;
+    switch (rand() % 4) {
+    case 0:
+      m = m.insert(std::make_pair(key, i));
+      ref.insert(std::make_pair(key, i));
+      break;
+    case 1:
+      m = m.replace(std::make_pair(key, i));
+      ref[key] = i;
+      break;
+    default:
+      m = m.remove(key);
+      ref.erase(key);
+      break;
+    }
+
+    // Keep a few old versions around to check they are never modified.
+    if (i % 2000 == 0) {
+      versions.push_back(m);
+      refVersions.push_back(ref);
+    }
+  }
+  checkEqual(m, ref);
+
+  for (unsigned i = 0; i < versions.size(); ++i)
+    checkEqual(versions[i], refVersions[i]);
+}
+
+TEST(ImmutableBTreeTest, Lookups) {
+  BTreeMap m;
+  RefMap ref;
+  for (unsigned i = 0; i < 1000; ++i) {
+    m = m.insert(std::make_pair(i * 4, i));
+    ref[i * 4] = i;
+  }
+
+  for (unsigned k = 0; k < 4100; ++k) {
+    const BTreeMap::value_type *res = m.lookup(k);
+    EXPECT_EQ(ref.count(k), m.count(k));
+    EXPECT_EQ(ref.count(k) != 0, res != 0);
+
+    res = m.lookup_previous(k);
+    RefMap::iterator ub = ref.upper_bound(k);
+    if (ub == ref.begin()) {
+      EXPECT_TRUE(res == 0);
+    } else {
+      --ub;
+      ASSERT_TRUE(res != 0);
+      EXPECT_EQ(ub->first, res->first);
+    }
+
+    BTreeMap::iterator lb = m.lower_bound(k);
+    if (ref.lower_bound(k) == ref.end())
+      EXPECT_TRUE(lb == m.end());
+    else
+      EXPECT_EQ(ref.lower_bound(k)->first, lb->first);
+
+    BTreeMap::iterator ubi = m.upper_bound(k);
+    if (ref.upper_bound(k) == ref.end())
+      EXPECT_TRUE(ubi == m.end());
+    else
+      EXPECT_EQ(ref.upper_bound(k)->first, ubi->first);
+
+    BTreeMap::iterator fi = m.find(k);
+    EXPECT_EQ(ref.count(k) != 0, fi != m.end());
+  }
+}
+
+TEST(ImmutableBTreeTest, NodesAreReleased) {
+  size_t before = BTreeMap::getAllocated();
+  {
+    BTreeMap m;
+    for (unsigned i = 0; i < 5000; ++i)
+      m = m.insert(std::make_pair(i, i));
+    BTreeMap copy = m;
+    for (unsigned i = 0; i < 5000; i += 2)
+      copy = copy.replace(std::make_pair(i, 0));
+    // An outstanding iterator must release its nodes as well.
+    BTreeMap::iterator it = copy.begin();
+    while (!m.empty()) {
+      BTreeMap::value_type v;
+      m = m.popMin(v);
+    }
+    EXPECT_EQ(0u, m.size());
+  }
+  EXPECT_EQ(before, BTreeMap::getAllocated());
+}
+
+template<class M>
+double timeLookupsAndWrites(unsigned objects, unsigned rounds) {
+  M m;
+  for (unsigned i = 0; i < objects; ++i)
+    m = m.insert(std::make_pair(i * 128, i));
+
+  clock_t start = clock();
+  unsigned sum = 0;
+  for (unsigned r = 0; r < rounds; ++r) {
+    // Fork, then do copy-on-write updates and lookups in the child.
+    M child = m;
+    for (unsigned i = 0; i < objects / 16; ++i) {
+      unsigned key = (rand() % objects) * 128;
+      sum += child.lookup_previous(key + 5)->second;
+      child = child.replace(std::make_pair(key, r));
+    }
+  }
+  EXPECT_NE(~0u, sum);
+  return double(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Benchmark at the object counts S2E reaches when splitting guest RAM into
+// small objects. Run with --gtest_also_run_disabled_tests.
+TEST(ImmutableBTreeTest, DISABLED_BenchmarkAgainstAVL) {
+  const unsigned objects = 256 * 1024, rounds = 20;
+  srand(1);
+  double avl = timeLookupsAndWrites<AVLMap>(objects, rounds);
+  srand(1);
+  double btree = timeLookupsAndWrites<BTreeMap>(objects, rounds);
+  std::cout << "ImmutableTree: " << avl << "s, "
+            << "ImmutableBTree: " << btree << "s\n";
+}
+
+}
@@ -0,0 +1,67 @@
+//===-- ImmutableRadixArrayTest.cpp ---------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "gtest/gtest.h"
+
+#include "klee/Internal/ADT/ImmutableRadixArray.h"
+
+#include <vector>
+
+using namespace klee;
+
+namespace {
+
+typedef ImmutableRadixArray<unsigned, 2> Array;
+
+TEST(ImmutableRadixArrayTest, GetSet) {
+  Array a(100);
+  EXPECT_EQ(100u, a.size());
+  EXPECT_EQ(0u, a.get(0));
+  EXPECT_EQ(0u, a.get(99));
+
+  for (unsigned i = 0; i < 100; ++i)
+    a.set(i, i + 1);
+  for (unsigned i = 0; i < 100; ++i)
+    EXPECT_EQ(i + 1, a.get(i));
+}
+
+TEST(ImmutableRadixArrayTest, CopiesAreIndependent) {
+  size_t before = Array::getAllocated();
+  {
+    Array a(100);
+    for (unsigned i = 0; i < 100; ++i)
+      a.set(i, i);
+
+    Array b = a;
+    b.set(10, 1000);
+    b.set(11, 1001);
+    a.set(90, 2000);
+
+    EXPECT_EQ(10u, a.get(10));
+    EXPECT_EQ(1000u, b.get(10));
+    EXPECT_EQ(2000u, a.get(90));
+    EXPECT_EQ(90u, b.get(90));
+
+    std::vector<size_t> changed;
+    a.diff(b, changed);
+    ASSERT_EQ(3u, changed.size());
+    EXPECT_EQ(10u, changed[0]);
+    EXPECT_EQ(11u, changed[1]);
+    EXPECT_EQ(90u, changed[2]);
+
+    // The writes after the copy only duplicated the paths they touched.
+    changed.clear();
+    Array c = b;
+    c.diff(b, changed);
+    EXPECT_TRUE(changed.empty());
+  }
+  EXPECT_EQ(before, Array::getAllocated());
+}
+
+}
@@ -0,0 +1,206 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov (vitaly.chipounov@epfl.ch)
+ *    Volodymyr Kuznetsov (vova.kuznetsov@epfl.ch)
+ *
+ * All contributors listed in S2E-AUTHORS.
+ *
+ */
+
+/**
+ * Symbolic-aware replacements for the lazy eflags helpers of the x86 target.
+ *
+ * When a branch depends on flags computed in a previous translation block,
+ * QEMU calls helper_cc_compute_c/helper_cc_compute_all with the pending
+ * CC_OP. Interpreting these helpers in KLEE yields large expressions
+ * (e.g., src1 is recomputed as CC_DST + CC_SRC, the parity flag is a
+ * symbolic lookup in parity_table). The handlers below build compact
+ * expressions directly from the operands of the pending operation.
+ * Whenever the pattern is not recognized, the original helper is
+ * interpreted as usual.
+ */
+
+extern "C" {
+#include <qemu-common.h>
+#include <cpu-all.h>
+#include <cpu.h>
+#include <exec-all.h>
+}
+
+#include <klee/util/FlagsExpr.h>
+#include "S2EExecutor.h"
+#include "S2EExecutionState.h"
+
+#include <klee/Expr.h>
+#include <klee/Statistic.h>
+#include <klee/Internal/Module/KInstruction.h>
+
+#include <llvm/Module.h>
+#include <llvm/Support/CallSite.h>
+#include <llvm/Support/CommandLine.h>
+
+using namespace klee;
+
+namespace {
+    llvm::cl::opt<bool>
+    SpecializeSymbolicFlags("specialize-symbolic-flags",
+            llvm::cl::desc("Build compact branch conditions from symbolic CC_OP operands"
+                           " instead of interpreting the lazy eflags helpers"),
+            llvm::cl::init(false));
+}
+
+namespace klee {
+namespace stats {
+    Statistic specializedFlagsComputations("SpecializedFlagsComputations", "SpecFlags");
+} // namespace stats
+} // namespace klee
+
+namespace s2e {
+
+namespace {
+
+/** Decodes a CC_OP into the operation kind and the operand width */
+FlagsOpKind decodeCCOp(uint32_t op, Expr::Width &width)
+{
+    static const Expr::Width widths[] = {
+        Expr::Int8, Expr::Int16, Expr::Int32, Expr::Int64
+    };
+
+    FlagsOpKind kind;
+    uint32_t base;
+    if (op >= CC_OP_ADDB && op <= CC_OP_ADDQ) {
+        kind = FLAGS_OP_ADD; base = CC_OP_ADDB;
+    } else if (op >= CC_OP_SUBB && op <= CC_OP_SUBQ) {
+        kind = FLAGS_OP_SUB; base = CC_OP_SUBB;
+    } else if (op >= CC_OP_LOGICB && op <= CC_OP_LOGICQ) {
+        kind = FLAGS_OP_LOGIC; base = CC_OP_LOGICB;
+    } else {
+        return FLAGS_OP_UNSUPPORTED;
+    }
+
+    width = widths[op - base];
+    if (width > (Expr::Width) TARGET_LONG_BITS) {
+        return FLAGS_OP_UNSUPPORTED;
+    }
+    return kind;
+}
+
+bool readFlagsOperands(S2EExecutionState *state, const ref<Expr> &opExpr,
+                       FlagsOpKind &kind, FlagsOperands &ops)
+{
+    ConstantExpr *ce = dyn_cast<ConstantExpr>(opExpr);
+    if (!ce) {
+        return false;
+    }
+
+    Expr::Width w = 0;
+    kind = decodeCCOp(ce->getZExtValue(), w);
+    if (kind == FLAGS_OP_UNSUPPORTED) {
+        return false;
+    }
+
+    ref<Expr> ccDst = state->readCpuRegister(CPU_OFFSET(cc_dst), TARGET_LONG_BITS);
+    ref<Expr> ccSrc = state->readCpuRegister(CPU_OFFSET(cc_src), TARGET_LONG_BITS);
+
+    //The helpers are cheap enough on concrete operands
+    if (isa<ConstantExpr>(ccDst) && isa<ConstantExpr>(ccSrc)) {
+        return false;
+    }
+
+    ops = getFlagsOperands(kind, ccDst, ccSrc, w);
+    return true;
+}
+
+} // anonymous namespace
+
+void S2EExecutor::handle_cc_compute_c(Executor* executor,
+                                      ExecutionState* state,
+                                      klee::KInstruction* target,
+                                      std::vector< ref<Expr> > &args)
+{
+    S2EExecutor* s2eExecutor = static_cast<S2EExecutor*>(executor);
+    S2EExecutionState* s2eState = static_cast<S2EExecutionState*>(state);
+    assert(args.size() == 1);
+
+    FlagsOpKind kind;
+    FlagsOperands ops;
+    if (!readFlagsOperands(s2eState, args[0], kind, ops)) {
+        llvm::CallSite cs(target->inst);
+        s2eExecutor->executeOverridenFunction(*state, cs.getCalledFunction(),
+                                              args);
+        return;
+    }
+
+    ++stats::specializedFlagsComputations;
+    s2eExecutor->bindLocal(target, *state, flagsBit(computeCarry(kind, ops), 0));
+}
+
+void S2EExecutor::handle_cc_compute_all(Executor* executor,
+                                        ExecutionState* state,
+                                        klee::KInstruction* target,
+                                        std::vector< ref<Expr> > &args)
+{
+    S2EExecutor* s2eExecutor = static_cast<S2EExecutor*>(executor);
+    S2EExecutionState* s2eState = static_cast<S2EExecutionState*>(state);
+    assert(args.size() == 1);
+
+    FlagsOpKind kind;
+    FlagsOperands ops;
+    if (!readFlagsOperands(s2eState, args[0], kind, ops)) {
+        llvm::CallSite cs(target->inst);
+        s2eExecutor->executeOverridenFunction(*state, cs.getCalledFunction(),
+                                              args);
+        return;
+    }
+
+    ++stats::specializedFlagsComputations;
+    s2eExecutor->bindLocal(target, *state, computeAllFlags(kind, ops));
+}
+
+void S2EExecutor::replaceFlagsHelpersWithSpecialHandlers()
+{
+    if (!SpecializeSymbolicFlags) {
+        return;
+    }
+
+    static const HandlerInfo handlers[] = {
+        { "helper_cc_compute_c", &S2EExecutor::handle_cc_compute_c },
+        { "helper_cc_compute_all", &S2EExecutor::handle_cc_compute_all }
+    };
+
+    for (unsigned i = 0; i < sizeof(handlers) / sizeof(handlers[0]); ++i) {
+        llvm::Function *f = kmodule->module->getFunction(handlers[i].name);
+        assert(f && "Could not find eflags helper");
+        addSpecialFunctionHandler(f, handlers[i].handler);
+        overridenInternalFunctions.insert(f);
+    }
+}
+
+} // namespace s2e
@@ -49,10 +49,27 @@ extern CPUArchState *env;
 #include <s2e/Plugins/CorePlugin.h>
 #include <s2e/s2e_qemu.h>
 
+#include <s2e/S2EStatsTracker.h>
+
+#include <klee/StatsTracker.h>
+#include <klee/Solver.h>
+#include <klee/Internal/Module/KModule.h>
+
 #include <llvm/Module.h>
+#include <llvm/Support/CommandLine.h>
 
 using namespace klee;
 
+extern llvm::cl::opt<bool> ConcolicMode;
+
+namespace {
+    llvm::cl::opt<bool>
+    BoundedSymbolicAddresses("bounded-symbolic-addresses",
+            llvm::cl::desc("Access memory at a symbolic address without forking when all its "
+                           "values fall in one RAM object (requires fast helpers)"),
+            llvm::cl::init(false));
+}
+
 namespace s2e {
 
 #define S2E_RAM_OBJECT_DIFF (TARGET_PAGE_BITS - S2E_RAM_OBJECT_BITS)
@@ -273,6 +290,106 @@ ref<ConstantExpr> S2EExecutor::handleForkAndConcretizeNative(Executor* executor,
     return constantAddress;
 }
 
+/**
+ *  Performs a RAM access at a symbolic address without forking, if the
+ *  solver proves that all the feasible addresses fall in the RAM object
+ *  that holds the current example address. The access becomes a read or
+ *  a write at a symbolic offset of that object, which replaces one fork
+ *  per possible address with one query. Returns false if the address
+ *  must be concretized instead, e.g., when it may point to another
+ *  object, to I/O memory, to a page that is not in the TLB, or to a
+ *  page that is not marked dirty.
+ */
+bool S2EExecutor::accessBoundedSymbolicAddress(Executor* executor,
+                                               ExecutionState* state,
+                                               klee::KInstruction* target,
+                                               ref<Expr> address, unsigned mmu_idx,
+                                               bool isWrite, unsigned data_size,
+                                               ref<Expr> &value)
+{
+    S2EExecutor *s2eExecutor = static_cast<S2EExecutor*>(executor);
+    S2EExecutionState *s2estate = static_cast<S2EExecutionState*>(state);
+
+    if (!BoundedSymbolicAddresses || state->forkDisabled) {
+        return false;
+    }
+
+    address = state->constraints.simplifyExpr(address);
+    if (isa<ConstantExpr>(address)) {
+        return false;
+    }
+
+    ref<ConstantExpr> example;
+    if (ConcolicMode) {
+        example = dyn_cast<ConstantExpr>(state->concolics.evaluate(address));
+        assert(!example.isNull() && "Could not evaluate address");
+    } else if (!s2eExecutor->getSolver()->getValue(
+                   Query(state->constraints, address), example)) {
+        return false;
+    }
+
+    target_ulong addr = example->getZExtValue();
+    target_ulong objectAddress = addr & S2E_RAM_OBJECT_MASK;
+    Expr::Width pointerWidth = address->getWidth();
+
+    ref<Expr> offset = SubExpr::create(address,
+                                       ConstantExpr::create(objectAddress, pointerWidth));
+    ref<Expr> inBounds = UleExpr::create(offset,
+            ConstantExpr::create(S2E_RAM_OBJECT_SIZE - data_size, pointerWidth));
+
+    bool valid;
+    if (!s2eExecutor->getSolver()->mustBeTrue(Query(state->constraints, inBounds), valid) ||
+            !valid) {
+        return false;
+    }
+
+    target_ulong object_index = addr >> S2E_RAM_OBJECT_BITS;
+    target_ulong index = (object_index >> S2E_RAM_OBJECT_DIFF) & (CPU_TLB_SIZE - 1);
+    target_ulong tlb_addr = isWrite ? env->tlb_table[mmu_idx][index].addr_write
+                                    : env->tlb_table[mmu_idx][index].ADDR_READ;
+
+    //tlb_fill may raise a guest fault at the example address, which would
+    //be taken without constraining the address to it. Let the concretizing
+    //path handle pages that are not in the TLB.
+    if ((addr & TARGET_PAGE_MASK) != (tlb_addr & (TARGET_PAGE_MASK | TLB_INVALID_MASK))) {
+        return false;
+    }
+
+    //I/O and not dirty pages need the concrete address
+    if (tlb_addr & ~TARGET_PAGE_MASK) {
+        return false;
+    }
+
+    uintptr_t hostAddress = objectAddress + env->tlb_table[mmu_idx][index].addend;
+    ObjectPair op = s2estate->addressSpace.findObject(hostAddress);
+    if (!op.first || op.first->isSharedConcrete) {
+        return false;
+    }
+
+    assert(op.first->size == S2E_RAM_OBJECT_SIZE);
+
+    if (isWrite) {
+        ObjectState *wos = s2estate->addressSpace.getWriteable(op.first, op.second);
+        wos->write(offset, value);
+    } else {
+        value = op.second->read(offset, data_size * 8);
+    }
+
+    ++stats::boundedSymbolicAccesses;
+
+    //Trace the access at the example address
+    std::vector<ref<Expr> > traceArgs;
+    traceArgs.push_back(address);
+    traceArgs.push_back(ConstantExpr::create(hostAddress + (addr - objectAddress), Expr::Int64));
+    traceArgs.push_back(value);
+    traceArgs.push_back(ConstantExpr::create(data_size * 8, Expr::Int64));
+    traceArgs.push_back(ConstantExpr::create(isWrite, Expr::Int64)); //isWrite
+    traceArgs.push_back(ConstantExpr::create(0, Expr::Int64)); //isIO
+    handlerTraceMemoryAccess(executor, state, target, traceArgs);
+
+    return true;
+}
+
 /* Replacement for __ldl_mmu / __stl_mmu */
 /* Params: ldl: addr, mmu_idx */
 /* Params: stl: addr, val, mmu_idx */
@@ -288,6 +405,26 @@ ref<Expr> S2EExecutor::handle_ldst_mmu(Executor* executor,
     ref<Expr> symbAddress = args[0];
     unsigned mmu_idx = dyn_cast<ConstantExpr>(args[isWrite ? 2 : 1])->getZExtValue();
 
+    if (isWrite) {
+        args[1] = executor->limitExprComplexity(*state, args[1]);
+    }
+
+    if (!isa<ConstantExpr>(symbAddress)) {
+        ref<Expr> value;
+        if (isWrite) {
+            value = args[1];
+        }
+
+        if (accessBoundedSymbolicAddress(executor, state, target, symbAddress,
+                                         mmu_idx, isWrite, data_size, value)) {
+            if (!isWrite && zeroExtend) {
+                assert(data_size == 2);
+                value = ZExtExpr::create(value, Expr::Int32);
+            }
+            return isWrite ? ref<Expr>() : value;
+        }
+    }
+
     ref<ConstantExpr> constantAddress =
             handleForkAndConcretizeNative(executor, state, target, args);
 
@@ -616,6 +753,24 @@ void S2EExecutor::replaceExternalFunctionsWithSpecialHandlers()
     }
 }
 
+void S2EExecutor::executeOverridenFunction(ExecutionState &state,
+                                           llvm::Function *function,
+                                           std::vector< ref<Expr> > &args)
+{
+    KFunction *kf = kmodule->functionMap[function];
+    assert(kf && "Overriden function has no body");
+
+    state.pushFrame(state.prevPC, kf);
+    state.pc = kf->instructions;
+
+    if (statsTracker)
+        statsTracker->framePushed(state, &state.stack[state.stack.size()-2]);
+
+    assert(args.size() >= function->arg_size());
+    for (unsigned i = 0; i < function->arg_size(); ++i)
+        bindArgument(kf, i, state, args[i]);
+}
+
 static const char *s_disabledHelpers[] = {
     "helper_load_seg" //, "helper_iret_protected"
 };
@@ -201,12 +201,33 @@ public:
 
     sigc::signal<void> onTimer;
 
+    /** Signal emitted before S2E destroys the plugins */
+    sigc::signal<void> onEngineShutdown;
+
     /** Signal emitted when the state is forked */
     sigc::signal<void, S2EExecutionState* /* originalState */,
                  const std::vector<S2EExecutionState*>& /* newStates */,
                  const std::vector<klee::ref<klee::Expr> >& /* newConditions */>
             onStateFork;
 
+    /**
+     * Signal emitted before a constraint is added to the path constraints
+     * of a state. isBranch is set for the direction taken at a fork and
+     * cleared for concretizations and other constraints.
+     */
+    sigc::signal<void, S2EExecutionState*,
+                 const klee::ref<klee::Expr>& /* constraint */,
+                 bool /* isBranch */>
+            onConstraintAdded;
+
+    /**
+     * Signal emitted after other was merged into base. The path
+     * constraints of base are replaced by the merged constraints.
+     */
+    sigc::signal<void, S2EExecutionState* /* base */,
+                 S2EExecutionState* /* other */>
+            onStateMerge;
+
     sigc::signal<void,
                  S2EExecutionState*, /* currentState */
                  S2EExecutionState*> /* nextState */
@@ -0,0 +1,253 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+
+#include "ConstraintTracer.h"
+
+#include <s2e/S2E.h>
+#include <s2e/ConfigFile.h>
+#include <s2e/Utils.h>
+
+namespace s2e {
+namespace plugins {
+
+using namespace klee;
+
+S2E_DEFINE_PLUGIN(ConstraintTracer, "Streams path constraints for offline solving", "",);
+
+void ConstraintTracer::initialize()
+{
+    m_maxExprs = s2e()->getConfig()->getInt(getConfigKey() + ".maxExprs", 1000000);
+
+    createNewLogFile();
+
+    s2e()->getCorePlugin()->onConstraintAdded.connect(
+            sigc::mem_fun(*this, &ConstraintTracer::onConstraintAdded));
+
+    s2e()->getCorePlugin()->onStateKill.connect(
+            sigc::mem_fun(*this, &ConstraintTracer::onStateKill));
+
+    s2e()->getCorePlugin()->onStateMerge.connect(
+            sigc::mem_fun(*this, &ConstraintTracer::onStateMerge));
+
+    s2e()->getCorePlugin()->onTimer.connect(
+            sigc::mem_fun(*this, &ConstraintTracer::onTimer));
+
+    s2e()->getCorePlugin()->onProcessFork.connect(
+            sigc::mem_fun(*this, &ConstraintTracer::onProcessFork));
+}
+
+ConstraintTracer::~ConstraintTracer()
+{
+    flush();
+    if (m_logFile) {
+        fclose(m_logFile);
+    }
+    delete m_writer;
+}
+
+void ConstraintTracer::createNewLogFile()
+{
+    m_fileName = s2e()->getOutputFilename("ConstraintTracer.dat");
+    m_logFile = fopen(m_fileName.c_str(), "wb");
+    if (!m_logFile) {
+        s2e()->getWarningsStream() << "Could not create ConstraintTracer.dat" << '\n';
+        exit(-1);
+    }
+
+    delete m_writer;
+    m_writer = new ExprStreamWriter();
+    m_nextSequence = 0;
+    ++m_generation;
+}
+
+void ConstraintTracer::writeBuffer()
+{
+    const std::vector<unsigned char> &buffer = m_writer->getBuffer();
+    if (!buffer.empty()) {
+        if (fwrite(&buffer[0], buffer.size(), 1, m_logFile) != 1) {
+            //at this point the log is corrupted.
+            assert(false);
+        }
+        m_writer->clearBuffer();
+    }
+}
+
+void ConstraintTracer::flush()
+{
+    if (m_logFile) {
+        writeBuffer();
+        fflush(m_logFile);
+    }
+}
+
+void ConstraintTracer::writeStateRecord(S2EExecutionState *state,
+                                        ConstraintTracerState *plgState)
+{
+    std::vector<unsigned> ids;
+    foreach2(it, state->constraints.begin(), state->constraints.end()) {
+        ids.push_back(m_writer->write(*it));
+    }
+
+    uint64_t sequence = m_nextSequence++;
+    m_writer->writeVarint(ConstraintLog::StateRecord);
+    m_writer->writeVarint(sequence);
+    m_writer->writeVarint(state->getID());
+    m_writer->writeVarint(ids.size());
+    foreach2(it, ids.begin(), ids.end()) {
+        m_writer->writeVarint(*it);
+    }
+
+    plgState->m_generation = m_generation;
+    plgState->m_owner = state->getID();
+    plgState->m_sequence = sequence;
+    plgState->m_logged = ids.size();
+}
+
+void ConstraintTracer::onConstraintAdded(S2EExecutionState *state,
+                                         const klee::ref<klee::Expr> &constraint,
+                                         bool isBranch)
+{
+    DECLARE_PLUGINSTATE(ConstraintTracerState, state);
+    uint32_t stateId = state->getID();
+
+    /* Ids are only written between records */
+    if (m_writer->getNumExprs() > m_maxExprs) {
+        m_writer->reset();
+    }
+
+    if (plgState->m_generation != m_generation) {
+        /* First constraint of the state in this file, list the previous
+           ones. The tool keeps the expressions, not their ids, so a later
+           reset of the writer does not require listing them again. */
+        writeStateRecord(state, plgState);
+    } else if (plgState->m_owner != stateId) {
+        /* Forked state, its constraints so far are a prefix of the
+           sequence of its parent */
+        uint64_t sequence = m_nextSequence++;
+        m_writer->writeVarint(ConstraintLog::ForkRecord);
+        m_writer->writeVarint(sequence);
+        m_writer->writeVarint(stateId);
+        m_writer->writeVarint(plgState->m_sequence);
+        m_writer->writeVarint(plgState->m_logged);
+
+        plgState->m_owner = stateId;
+        plgState->m_sequence = sequence;
+    }
+
+    unsigned id = m_writer->write(constraint);
+    m_writer->writeVarint(ConstraintLog::ConstraintRecord);
+    m_writer->writeVarint(plgState->m_sequence);
+    m_writer->writeVarint(state->getPc());
+    m_writer->writeVarint(isBranch ? ConstraintLog::BranchFlag : 0);
+    m_writer->writeVarint(id);
+    ++plgState->m_logged;
+
+    if (m_writer->getBuffer().size() >= 64 * 1024) {
+        writeBuffer();
+    }
+}
+
+void ConstraintTracer::onStateKill(S2EExecutionState *state)
+{
+    DECLARE_PLUGINSTATE(ConstraintTracerState, state);
+    if (plgState->m_generation != m_generation ||
+        plgState->m_owner != (uint32_t) state->getID()) {
+        return;
+    }
+
+    m_writer->writeVarint(ConstraintLog::KillRecord);
+    m_writer->writeVarint(plgState->m_sequence);
+}
+
+void ConstraintTracer::onStateMerge(S2EExecutionState *base,
+                                    S2EExecutionState *other)
+{
+    /* The merged constraints are not an extension of the logged ones,
+       list them again in a new sequence. States forked before the merge
+       still refer to the old one. The other state is killed afterwards. */
+    DECLARE_PLUGINSTATE(ConstraintTracerState, base);
+
+    if (m_writer->getNumExprs() > m_maxExprs) {
+        m_writer->reset();
+    }
+
+    writeStateRecord(base, plgState);
+}
+
+void ConstraintTracer::onTimer()
+{
+    flush();
+}
+
+void ConstraintTracer::onProcessFork(bool preFork, bool isChild, unsigned parentProcId)
+{
+    if (preFork) {
+        flush();
+    } else if (isChild) {
+        /* The child has its own output directory, the parent keeps
+           appending to the old file */
+        fclose(m_logFile);
+        createNewLogFile();
+    }
+}
+
+/***/
+
+ConstraintTracerState::ConstraintTracerState()
+{
+    m_generation = 0;
+    m_owner = 0;
+    m_sequence = 0;
+    m_logged = 0;
+}
+
+ConstraintTracerState::~ConstraintTracerState()
+{
+
+}
+
+PluginState *ConstraintTracerState::clone() const
+{
+    return new ConstraintTracerState(*this);
+}
+
+PluginState *ConstraintTracerState::factory(Plugin *p, S2EExecutionState *s)
+{
+    return new ConstraintTracerState();
+}
+
+} // namespace plugins
+} // namespace s2e
@@ -0,0 +1,127 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+
+#ifndef S2E_PLUGINS_CONSTRAINTTRACER_H
+#define S2E_PLUGINS_CONSTRAINTTRACER_H
+
+#include <s2e/Plugin.h>
+#include <s2e/Plugins/CorePlugin.h>
+#include <s2e/S2EExecutionState.h>
+
+#include <klee/util/ExprStream.h>
+
+#include <stdio.h>
+
+namespace s2e {
+namespace plugins {
+
+class ConstraintTracerState;
+
+/**
+ *  Streams the path constraints of every state to ConstraintTracer.dat,
+ *  in the format of klee::ConstraintLog, so that the queries of the paths
+ *  can be rebuilt and solved offline by klee-solve-log.
+ *
+ *  Each record carries the pc and whether the constraint is the direction
+ *  taken at a branch or a concretization. Expressions are hash-consed by
+ *  klee::ExprStreamWriter, a subterm shared by several constraints or
+ *  states is written once.
+ */
+class ConstraintTracer : public Plugin
+{
+    S2E_PLUGIN
+
+    std::string m_fileName;
+    FILE *m_logFile;
+    klee::ExprStreamWriter *m_writer;
+
+    /* Incremented each time a new file is started, states logged to an
+       older file list their constraints again */
+    unsigned m_generation;
+
+    /* The writer forgets its expressions past this count */
+    unsigned m_maxExprs;
+
+    /* Id of the next constraint sequence started in the current file */
+    uint64_t m_nextSequence;
+
+    void createNewLogFile();
+    void writeBuffer();
+    void writeStateRecord(S2EExecutionState *state,
+                          ConstraintTracerState *plgState);
+
+    void onConstraintAdded(S2EExecutionState *state,
+                           const klee::ref<klee::Expr> &constraint,
+                           bool isBranch);
+    void onStateKill(S2EExecutionState *state);
+    void onStateMerge(S2EExecutionState *base, S2EExecutionState *other);
+    void onTimer();
+    void onProcessFork(bool preFork, bool isChild, unsigned parentProcId);
+
+public:
+    ConstraintTracer(S2E* s2e): Plugin(s2e), m_logFile(NULL), m_writer(NULL),
+        m_generation(0), m_nextSequence(0) {}
+    ~ConstraintTracer();
+    void initialize();
+
+    void flush();
+};
+
+class ConstraintTracerState: public PluginState
+{
+private:
+    /* Generation of the file the constraints were logged to */
+    unsigned m_generation;
+
+    /* State that started the sequence holding the constraints of this
+       state, the parent until the first constraint of a forked state */
+    uint32_t m_owner;
+    uint64_t m_sequence;
+    unsigned m_logged;
+
+public:
+    ConstraintTracerState();
+    virtual ~ConstraintTracerState();
+    virtual PluginState *clone() const;
+    static PluginState *factory(Plugin *p, S2EExecutionState *s);
+
+    friend class ConstraintTracer;
+};
+
+} // namespace plugins
+} // namespace s2e
+
+#endif // S2E_PLUGINS_CONSTRAINTTRACER_H
@@ -99,6 +99,13 @@ void ExecutionTracer::onTimer()
 uint32_t ExecutionTracer::writeData(
         const S2EExecutionState *state,
         void *data, unsigned size, ExecTraceEntryType type)
+{
+    return writeData(state->getID(), state->getPid(), data, size, type);
+}
+
+uint32_t ExecutionTracer::writeData(
+        uint32_t stateId, uint64_t pid,
+        void *data, unsigned size, ExecTraceEntryType type)
 {
     ExecutionTraceItemHeader item;
 
@@ -107,8 +114,8 @@ uint32_t ExecutionTracer::writeData(
     item.timeStamp = llvm::sys::TimeValue::now().usec();
     item.size = size;
     item.type = type;
-    item.stateId = state->getID();
-    item.pid = state->getPid();
+    item.stateId = stateId;
+    item.pid = pid;
 
     if (fwrite(&item, sizeof(item), 1, m_LogFile) != 1) {
         return 0;
@@ -80,6 +80,11 @@ public:
             const S2EExecutionState *state,
             void *data, unsigned size, ExecTraceEntryType type);
 
+    /** Write an entry on behalf of a state that may no longer exist */
+    uint32_t writeData(
+            uint32_t stateId, uint64_t pid,
+            void *data, unsigned size, ExecTraceEntryType type);
+
     void flush();
 private:
 
@@ -36,6 +36,7 @@
 #include <iomanip>
 #include <cctype>
 
+#include <s2e/ConfigFile.h>
 #include <s2e/S2E.h>
 #include <s2e/Utils.h>
 #include <s2e/S2EExecutionState.h>
@@ -53,13 +54,36 @@ TestCaseGenerator::TestCaseGenerator(S2E* s2e)
 {
     m_testIndex = 0;
     m_pathsExplored = 0;
-
+    m_tracer = NULL;
+    m_asynchronous = false;
+    m_maxPending = 0;
 }
 
 void TestCaseGenerator::initialize()
 {
+    m_tracer = static_cast<ExecutionTracer*>(s2e()->getPlugin("ExecutionTracer"));
+    assert(m_tracer);
+
+    /* Solve the constraints of terminated states in the background solver
+       processes of the executor instead of blocking the execution loop.
+       At most maxPending test cases wait for their solution. */
+    m_asynchronous = s2e()->getConfig()->getBool(getConfigKey() + ".asynchronous");
+    m_maxPending = s2e()->getConfig()->getInt(getConfigKey() + ".maxPending", 4);
+    if (m_maxPending == 0) {
+        m_maxPending = 1;
+    }
+
     s2e()->getCorePlugin()->onTestCaseGeneration.connect(
             sigc::mem_fun(*this, &TestCaseGenerator::onTestCaseGeneration));
+
+    if (m_asynchronous) {
+        s2e()->getCorePlugin()->onTimer.connect(
+                sigc::mem_fun(*this, &TestCaseGenerator::onTimer));
+        s2e()->getCorePlugin()->onProcessFork.connect(
+                sigc::mem_fun(*this, &TestCaseGenerator::onProcessFork));
+        s2e()->getCorePlugin()->onEngineShutdown.connect(
+                sigc::mem_fun(*this, &TestCaseGenerator::onEngineShutdown));
+    }
 }
 
 
@@ -70,6 +94,25 @@ void TestCaseGenerator::onTestCaseGeneration(S2EExecutionState *state, const std
             << " at address " << hexval(state->getPc())
             << '\n';
 
+    if (m_asynchronous) {
+        PendingTestCase testCase;
+        testCase.future = s2e()->getExecutor()->getSymbolicSolutionAsync(*state);
+        testCase.stateId = state->getID();
+        testCase.pid = state->getPid();
+
+        if (testCase.future) {
+            if (m_pending.size() >= m_maxPending) {
+                completeTestCase(m_pending.front());
+                m_pending.pop_front();
+            }
+            m_pending.push_back(testCase);
+            return;
+        }
+
+        s2e()->getWarningsStream() << "TestCaseGenerator: could not start a "
+                                      "background solver, solving in place\n";
+    }
+
     ConcreteInputs out;
     bool success = s2e()->getExecutor()->getSymbolicSolution(*state, out);
 
@@ -78,19 +121,67 @@ void TestCaseGenerator::onTestCaseGeneration(S2EExecutionState *state, const std
         return;
     }
 
-#if 0
-    foreach2(it, state.constraints.begin(), state.constraints.end()) {
-        s2e()->getMessagesStream() << "Constraint: " << std::hex << *it << '\n';
+    writeTestCase(state->getID(), state->getPid(), out);
+}
+
+/** Wait for the solution of the test case and write it */
+void TestCaseGenerator::completeTestCase(PendingTestCase &testCase)
+{
+    ConcreteInputs out;
+    bool success = testCase.future->get(out);
+    delete testCase.future;
+    testCase.future = NULL;
+
+    if (!success) {
+        s2e()->getWarningsStream() << "Could not get symbolic solutions for state "
+                                   << testCase.stateId << '\n';
+        return;
     }
-#endif
 
-    s2e()->getMessagesStream() << '\n';
+    s2e()->getMessagesStream() << "TestCaseGenerator: test case of state "
+                               << testCase.stateId << '\n';
+    writeTestCase(testCase.stateId, testCase.pid, out);
+}
 
-    ExecutionTracer *tracer = (ExecutionTracer*)s2e()->getPlugin("ExecutionTracer");
-    assert(tracer);
+/** Write the test cases whose solution is available, in the order in
+    which they were requested. Waits for all of them if wait is set. */
+void TestCaseGenerator::completeReadyTestCases(bool wait)
+{
+    while (!m_pending.empty()) {
+        PendingTestCase &testCase = m_pending.front();
+        if (!wait && !testCase.future->isReady()) {
+            break;
+        }
+        completeTestCase(testCase);
+        m_pending.pop_front();
+    }
+}
+
+void TestCaseGenerator::onTimer()
+{
+    completeReadyTestCases(false);
+}
+
+void TestCaseGenerator::onProcessFork(bool preFork, bool isChild, unsigned parentProcId)
+{
+    /* The solver processes belong to the parent */
+    if (preFork) {
+        completeReadyTestCases(true);
+    }
+}
+
+void TestCaseGenerator::onEngineShutdown()
+{
+    completeReadyTestCases(true);
+}
+
+void TestCaseGenerator::writeTestCase(uint32_t stateId, uint64_t pid,
+                                      const ConcreteInputs &out)
+{
+    s2e()->getMessagesStream() << '\n';
 
     std::stringstream ss;
-    ConcreteInputs::iterator it;
+    ConcreteInputs::const_iterator it;
     for (it = out.begin(); it != out.end(); ++it) {
         const VarValuePair &vp = *it;
         ss << std::setw(20) << vp.first << ": ";
@@ -123,7 +214,7 @@ void TestCaseGenerator::onTestCaseGeneration(S2EExecutionState *state, const std
 
     unsigned bufsize;
     ExecutionTraceTestCase *tc = ExecutionTraceTestCase::serialize(&bufsize, out);
-    tracer->writeData(state, tc, bufsize, TRACE_TESTCASE);
+    m_tracer->writeData(stateId, pid, tc, bufsize, TRACE_TESTCASE);
     ExecutionTraceTestCase::deallocate(tc);
 }
 
@@ -37,11 +37,16 @@
 #define S2E_PLUGINS_TCGEN_H
 
 #include <s2e/Plugin.h>
+#include <s2e/SolutionFuture.h>
+
+#include <deque>
 #include <string>
 
 namespace s2e{
 namespace plugins{
 
+class ExecutionTracer;
+
 /** Handler required for KLEE interpreter */
 class TestCaseGenerator : public Plugin
 {
@@ -51,16 +56,36 @@ private:
     typedef std::pair<std::string, std::vector<unsigned char> > VarValuePair;
     typedef std::vector<VarValuePair> ConcreteInputs;
 
+    /** Test case whose solution is computed in the background */
+    struct PendingTestCase {
+        SolutionFuture *future;
+        uint32_t stateId;
+        uint64_t pid;
+    };
+
     unsigned m_testIndex;  // number of tests written so far
     unsigned m_pathsExplored; // number of paths explored so far
 
+    ExecutionTracer *m_tracer;
+
+    bool m_asynchronous;
+    unsigned m_maxPending;
+    std::deque<PendingTestCase> m_pending;
+
 public:
     TestCaseGenerator(S2E* s2e);
 
     void initialize();
 
 private:
+    void writeTestCase(uint32_t stateId, uint64_t pid, const ConcreteInputs &out);
+    void completeTestCase(PendingTestCase &testCase);
+    void completeReadyTestCases(bool wait);
+
     void onTestCaseGeneration(S2EExecutionState *state, const std::string &message);
+    void onTimer();
+    void onProcessFork(bool preFork, bool isChild, unsigned parentProcId);
+    void onEngineShutdown();
 };
 
 
@@ -0,0 +1,422 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+extern "C" {
+#include "config.h"
+#include "qemu-common.h"
+#include "qemu-timer.h"
+#include "sysemu.h"
+#include "cpu.h"
+extern CPUArchState *env;
+}
+
+#include "ForkServer.h"
+#include <s2e/S2E.h>
+#include <s2e/S2EExecutor.h>
+#include <s2e/ConfigFile.h>
+#include <s2e/Utils.h>
+#include <s2e/s2e_qemu.h>
+#include <s2e/Plugins/Opcodes.h>
+
+#include <algorithm>
+#include <cstddef>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace s2e {
+namespace plugins {
+
+S2E_DEFINE_PLUGIN(ForkServer, "Runs concrete inputs in forks of a guest snapshot", "",);
+
+void ForkServer::initialize()
+{
+    ConfigFile *cfg = s2e()->getConfig();
+    bool ok;
+
+    m_controlPath = cfg->getString(getConfigKey() + ".controlFifo", "", &ok);
+    if (!ok) {
+        s2e()->getWarningsStream() << "ForkServer: must specify controlFifo\n";
+        exit(-1);
+    }
+
+    m_statusPath = cfg->getString(getConfigKey() + ".statusFifo", "", &ok);
+    if (!ok) {
+        s2e()->getWarningsStream() << "ForkServer: must specify statusFifo\n";
+        exit(-1);
+    }
+
+    std::string sharedPath = cfg->getString(getConfigKey() + ".sharedFile", "", &ok);
+    if (!ok) {
+        s2e()->getWarningsStream() << "ForkServer: must specify sharedFile\n";
+        exit(-1);
+    }
+
+    m_maxInputSize = cfg->getInt(getConfigKey() + ".maxInputSize", 1024 * 1024);
+    m_timeout = cfg->getInt(getConfigKey() + ".timeout", 1000);
+
+    size_t sharedSize = offsetof(ForkServerShared, input) + m_maxInputSize;
+    m_sharedFd = open(sharedPath.c_str(), O_RDWR | O_CREAT, 0600);
+    if (m_sharedFd < 0 || ftruncate(m_sharedFd, sharedSize) < 0) {
+        s2e()->getWarningsStream() << "ForkServer: could not open "
+                                   << sharedPath << ": " << strerror(errno) << '\n';
+        exit(-1);
+    }
+
+    void *shared = mmap(NULL, sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        m_sharedFd, 0);
+    if (shared == MAP_FAILED) {
+        s2e()->getWarningsStream() << "ForkServer: could not map "
+                                   << sharedPath << ": " << strerror(errno) << '\n';
+        exit(-1);
+    }
+    m_shared = static_cast<ForkServerShared*>(shared);
+
+    m_controlFd = m_statusFd = -1;
+    m_buffer = m_bufferSize = 0;
+    m_pending = m_child = m_injected = false;
+    m_previousLocation = 0;
+    m_runs = 0;
+    m_runPid = -1;
+    m_runFd = -1;
+    m_timer = NULL;
+    m_timeoutTimer = NULL;
+
+    s2e()->getCorePlugin()->onCustomInstruction.connect(
+            sigc::mem_fun(*this, &ForkServer::onCustomInstruction));
+    s2e()->getCorePlugin()->onStateKill.connect(
+            sigc::mem_fun(*this, &ForkServer::onStateKill));
+}
+
+/** Copy the input of the current run into the guest buffer, one page at
+    a time. Returns the number of bytes copied. */
+uint32_t ForkServer::injectInput(S2EExecutionState *state)
+{
+    uint64_t size = std::min(m_shared->inputSize, m_maxInputSize);
+    size = std::min(size, m_bufferSize);
+
+    uint64_t done = 0;
+    while (done < size) {
+        uint64_t address = m_buffer + done;
+        uint64_t hostAddress = state->getHostAddress(address);
+        if (hostAddress == (uint64_t) -1 ||
+                !state->isRamRegistered(hostAddress)) {
+            break;
+        }
+
+        unsigned length = std::min<uint64_t>(
+                TARGET_PAGE_SIZE - (address & ~TARGET_PAGE_MASK), size - done);
+        state->dmaWrite(hostAddress, &m_shared->input[done], length);
+        done += length;
+    }
+
+    return done;
+}
+
+/** End the run of a child process. The parent notices the exit in
+    runCallback and reports the status to the driver. */
+void ForkServer::finishRun()
+{
+    m_shared->status = FORKSERVER_EXITED;
+
+    s2e()->getWarningsStream().flush();
+    s2e()->getMessagesStream().flush();
+    s2e()->getDebugStream().flush();
+
+    /* Do not run the destructors, the files and the shared memory of
+       S2E belong to the server. */
+    _exit(0);
+}
+
+void ForkServer::serverCallback(void *opaque)
+{
+    static_cast<ForkServer*>(opaque)->serve();
+}
+
+void ForkServer::controlCallback(void *opaque)
+{
+    static_cast<ForkServer*>(opaque)->startRun();
+}
+
+/** The child holds the write end of the pipe until it exits */
+void ForkServer::runCallback(void *opaque)
+{
+    ForkServer *fs = static_cast<ForkServer*>(opaque);
+    int status;
+
+    waitpid(fs->m_runPid, &status, 0);
+    fs->endRun(fs->m_shared->status == FORKSERVER_EXITED ?
+               FORKSERVER_EXITED : FORKSERVER_CRASHED);
+}
+
+void ForkServer::timeoutCallback(void *opaque)
+{
+    ForkServer *fs = static_cast<ForkServer*>(opaque);
+    int status;
+
+    kill(fs->m_runPid, SIGKILL);
+    waitpid(fs->m_runPid, &status, 0);
+    fs->endRun(FORKSERVER_TIMEOUT);
+}
+
+/** Turn the process into a server, from a timer of the main loop. The VM
+    stays stopped in the server, which handles the requests and the end
+    of the runs from file descriptor handlers of the main loop. */
+void ForkServer::serve()
+{
+    if (!m_pending || m_child) {
+        return;
+    }
+    m_pending = false;
+
+    vm_stop(RUN_STATE_SAVE_VM);
+
+    /* The driver opens the control FIFO for writing first */
+    m_controlFd = open(m_controlPath.c_str(), O_RDONLY);
+    m_statusFd = m_controlFd < 0 ? -1 : open(m_statusPath.c_str(), O_WRONLY);
+    if (m_controlFd < 0 || m_statusFd < 0) {
+        s2e()->getWarningsStream() << "ForkServer: could not open the FIFOs: "
+                                   << strerror(errno) << '\n';
+        exit(-1);
+    }
+
+    /* Only the runs are instrumented. The blocks translated so far have
+       no coverage instrumentation, so the children must translate again. */
+    s2e()->getCorePlugin()->onTranslateBlockStart.connect(
+            sigc::mem_fun(*this, &ForkServer::onTranslateBlockStart));
+    tb_flush(env);
+
+    m_timeoutTimer = qemu_new_timer_ms(rt_clock, &timeoutCallback, this);
+    qemu_set_fd_handler(m_controlFd, &controlCallback, NULL, this);
+
+    s2e()->getMessagesStream() << "ForkServer: serving requests\n";
+}
+
+/** Read a request of the driver and fork a child to run it. Requests are
+    not read again until the run ends. Returns in the child, with the VM
+    running again. */
+void ForkServer::startRun()
+{
+    uint32_t request;
+    if (read(m_controlFd, &request, sizeof(request)) != sizeof(request)) {
+        closeConnection();
+        return;
+    }
+
+    m_shared->status = FORKSERVER_RUNNING;
+    m_shared->result = 0;
+    m_shared->executedBlocks = 0;
+    memset(m_shared->coverage, 0, sizeof(m_shared->coverage));
+
+    /* Buffered output would otherwise be written by every child */
+    s2e()->getWarningsStream().flush();
+    s2e()->getMessagesStream().flush();
+    s2e()->getDebugStream().flush();
+
+    int fds[2];
+    if (pipe(fds) < 0) {
+        endRun(FORKSERVER_FORK_FAILED);
+        return;
+    }
+
+    int pid = s2e()->forkSnapshot();
+    if (pid == 0) {
+        m_child = true;
+        qemu_set_fd_handler(m_controlFd, NULL, NULL, NULL);
+        close(m_controlFd);
+        close(m_statusFd);
+        close(fds[0]);
+        vm_start();
+        return;
+    }
+
+    close(fds[1]);
+    if (pid < 0) {
+        close(fds[0]);
+        endRun(FORKSERVER_FORK_FAILED);
+        return;
+    }
+
+    m_runPid = pid;
+    m_runFd = fds[0];
+    qemu_set_fd_handler(m_controlFd, NULL, NULL, NULL);
+    qemu_set_fd_handler(m_runFd, &runCallback, NULL, this);
+    qemu_mod_timer(m_timeoutTimer, qemu_get_clock_ms(rt_clock) + m_timeout);
+}
+
+/** Report the status of the run to the driver and wait for the next request */
+void ForkServer::endRun(uint32_t status)
+{
+    if (m_runFd >= 0) {
+        qemu_set_fd_handler(m_runFd, NULL, NULL, NULL);
+        close(m_runFd);
+        m_runFd = -1;
+    }
+    qemu_del_timer(m_timeoutTimer);
+    m_runPid = -1;
+
+    m_shared->status = status;
+    ++m_runs;
+
+    if (write(m_statusFd, &status, sizeof(status)) != sizeof(status)) {
+        closeConnection();
+        return;
+    }
+
+    qemu_set_fd_handler(m_controlFd, &controlCallback, NULL, this);
+}
+
+void ForkServer::closeConnection()
+{
+    qemu_set_fd_handler(m_controlFd, NULL, NULL, NULL);
+    s2e()->getMessagesStream() << "ForkServer: driver closed the connection after "
+                               << m_runs << " runs\n";
+    qemu_system_shutdown_request();
+}
+
+void ForkServer::handleInput(S2EExecutionState *state)
+{
+    if (m_child) {
+        /* The guest asks for another input once it is done with one */
+        if (m_injected) {
+            finishRun();
+        }
+
+        target_ulong size = injectInput(state);
+        state->writeCpuRegisterConcrete(CPU_OFFSET(FORKSERVER_RETURN), &size,
+                                        CPU_REG_SIZE);
+        m_injected = true;
+        return;
+    }
+
+    if (!m_pending) {
+        target_ulong buffer, size;
+        bool ok = true;
+        ok &= state->readCpuRegisterConcrete(CPU_OFFSET(FORKSERVER_BUFFER),
+                                             &buffer, CPU_REG_SIZE);
+        ok &= state->readCpuRegisterConcrete(CPU_OFFSET(FORKSERVER_SIZE),
+                                             &size, CPU_REG_SIZE);
+        if (!ok) {
+            s2e()->getWarningsStream(state)
+                << "ERROR: symbolic argument was passed to s2e_op ForkServer\n";
+            return;
+        }
+
+        m_buffer = buffer;
+        m_bufferSize = size;
+        m_pending = true;
+
+        if (!m_timer) {
+            m_timer = qemu_new_timer_ms(rt_clock, &serverCallback, this);
+        }
+
+        s2e()->getMessagesStream(state) << "ForkServer: waiting for the driver on "
+                                        << m_controlPath << '\n';
+    }
+
+    /* Keep the program counter on the custom instruction until the server
+       stops the VM. Every child executes it again to fetch its input. */
+    qemu_mod_timer(m_timer, qemu_get_clock_ms(rt_clock));
+    state->writeCpuState(CPU_OFFSET(exception_index), EXCP_S2E, 8*sizeof(int));
+    throw CpuExitException();
+}
+
+void ForkServer::onCustomInstruction(S2EExecutionState *state, uint64_t opcode)
+{
+    if (!OPCODE_CHECK(opcode, FORK_SERVER_OPCODE)) {
+        return;
+    }
+
+    uint8_t op = OPCODE_GETSUBFUNCTION(opcode);
+    switch (op) {
+        case 0: {
+            handleInput(state);
+        } break;
+
+        case 1: {
+            target_ulong result;
+            if (!state->readCpuRegisterConcrete(CPU_OFFSET(FORKSERVER_RESULT),
+                                                &result, CPU_REG_SIZE)) {
+                s2e()->getWarningsStream(state)
+                    << "ERROR: symbolic argument was passed to s2e_op ForkServer\n";
+                return;
+            }
+            if (m_child) {
+                m_shared->result = result;
+            }
+        } break;
+
+        default: {
+            s2e()->getWarningsStream(state)
+                    << "Invalid ForkServer opcode " << hexval(op) << '\n';
+        } break;
+    }
+}
+
+void ForkServer::onTranslateBlockStart(ExecutionSignal *signal,
+                                       S2EExecutionState *state,
+                                       TranslationBlock *tb,
+                                       uint64_t pc)
+{
+    signal->connect(sigc::mem_fun(*this, &ForkServer::onExecuteBlockStart));
+}
+
+void ForkServer::onExecuteBlockStart(S2EExecutionState *state, uint64_t pc)
+{
+    if (!m_child) {
+        return;
+    }
+
+    uint64_t location = ((pc >> 4) ^ (pc << 8)) & (FORKSERVER_MAP_SIZE - 1);
+    ++m_shared->coverage[location ^ m_previousLocation];
+    m_previousLocation = location >> 1;
+    ++m_shared->executedBlocks;
+}
+
+void ForkServer::onStateKill(S2EExecutionState *state)
+{
+    if (m_child) {
+        finishRun();
+    }
+}
+
+} // namespace plugins
+} // namespace s2e
@@ -0,0 +1,178 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_PLUGINS_FORKSERVER_H
+#define S2E_PLUGINS_FORKSERVER_H
+
+#include <s2e/Plugin.h>
+#include <s2e/Plugins/CorePlugin.h>
+#include <s2e/S2EExecutionState.h>
+
+#include <inttypes.h>
+#include <string>
+
+#ifdef TARGET_I386
+
+#define FORKSERVER_BUFFER regs[R_EAX]
+#define FORKSERVER_SIZE regs[R_ECX]
+#define FORKSERVER_RETURN regs[R_EAX]
+#define FORKSERVER_RESULT regs[R_EAX]
+
+#elif TARGET_ARM
+
+#define FORKSERVER_BUFFER regs[0]
+#define FORKSERVER_SIZE regs[1]
+#define FORKSERVER_RETURN regs[0]
+#define FORKSERVER_RESULT regs[0]
+
+#endif
+
+struct QEMUTimer;
+
+namespace s2e {
+namespace plugins {
+
+#define FORKSERVER_MAP_SIZE (1 << 16)
+
+enum ForkServerStatus {
+    /** The state of the run was terminated by the guest or by S2E */
+    FORKSERVER_EXITED = 0,
+    /** The run process died before its state was terminated */
+    FORKSERVER_CRASHED = 1,
+    /** The run did not terminate in time and was killed */
+    FORKSERVER_TIMEOUT = 2,
+    /** The run process could not be created */
+    FORKSERVER_FORK_FAILED = 3,
+    FORKSERVER_RUNNING = 4
+};
+
+/** Layout of the file shared with the driver */
+struct ForkServerShared {
+    /** Size of the input, written by the driver before each request */
+    uint32_t inputSize;
+    /** ForkServerStatus of the last run */
+    uint32_t status;
+    /** Value reported by the guest with s2e_fork_server_report */
+    uint32_t result;
+    uint32_t reserved;
+    /** Number of translation blocks executed by the last run */
+    uint64_t executedBlocks;
+    /** Hit counts of the edges between translation blocks */
+    uint8_t coverage[FORKSERVER_MAP_SIZE];
+    /** The input itself, maxInputSize bytes */
+    uint8_t input[1];
+};
+
+/**
+ *  Runs concrete inputs from a snapshot of the whole S2E process.
+ *
+ *  When the guest issues the custom instruction for the first time, the
+ *  plugin stops the VM and turns the process into a server. For each
+ *  request read from the control FIFO, the server forks the process and
+ *  waits for the child from the main loop of QEMU. The child inherits the
+ *  guest copy-on-write. The child copies the input from the shared file
+ *  into the guest buffer, returns its size in the custom instruction and
+ *  runs until its state is terminated. Edge coverage and the outcome of
+ *  the run are stored in the shared file, and the status is written back
+ *  to the status FIFO.
+ *
+ *  The children do not go through S2E's own fork, they share the output
+ *  directory of the server and are not counted in the process limit.
+ *  Symbolic execution should not be used in the children.
+ */
+class ForkServer : public Plugin
+{
+    S2E_PLUGIN
+public:
+    ForkServer(S2E* s2e): Plugin(s2e) {}
+
+    void initialize();
+
+private:
+    std::string m_controlPath;
+    std::string m_statusPath;
+    int m_controlFd;
+    int m_statusFd;
+
+    int m_sharedFd;
+    ForkServerShared *m_shared;
+    uint32_t m_maxInputSize;
+
+    /** Milliseconds a run may take before it is killed */
+    unsigned m_timeout;
+
+    /** Guest buffer that receives the inputs */
+    uint64_t m_buffer;
+    uint64_t m_bufferSize;
+
+    bool m_pending;
+    bool m_child;
+    bool m_injected;
+    uint64_t m_previousLocation;
+    uint64_t m_runs;
+
+    /** Child of the current run and the read end of its pipe */
+    int m_runPid;
+    int m_runFd;
+
+    struct QEMUTimer *m_timer;
+    struct QEMUTimer *m_timeoutTimer;
+
+    static void serverCallback(void *opaque);
+    static void controlCallback(void *opaque);
+    static void runCallback(void *opaque);
+    static void timeoutCallback(void *opaque);
+    void serve();
+    void startRun();
+    void endRun(uint32_t status);
+    void closeConnection();
+
+    uint32_t injectInput(S2EExecutionState *state);
+    void finishRun();
+    void handleInput(S2EExecutionState *state);
+
+    void onCustomInstruction(S2EExecutionState* state, uint64_t opcode);
+    void onTranslateBlockStart(ExecutionSignal *signal,
+                               S2EExecutionState *state,
+                               TranslationBlock *tb,
+                               uint64_t pc);
+    void onExecuteBlockStart(S2EExecutionState *state, uint64_t pc);
+    void onStateKill(S2EExecutionState *state);
+};
+
+} // namespace plugins
+} // namespace s2e
+
+#endif // S2E_PLUGINS_FORKSERVER_H
@@ -44,6 +44,7 @@ extern "C" {
 #include <s2e/Utils.h>
 #include <s2e/Plugins/Opcodes.h>
 
+#include <algorithm>
 #include <iostream>
 #include <errno.h>
 
@@ -59,6 +60,11 @@ namespace plugins {
 
 S2E_DEFINE_PLUGIN(HostFiles, "Access to host files", "",);
 
+/* Size of the host-side staging buffer used by read(). Guest requests
+   larger than this are served in several host reads within the same
+   custom instruction. */
+static const size_t HOSTFILES_CHUNK_SIZE = 1024 * 1024;
+
 void HostFiles::initialize()
 {
     //m_allowWrite = s2e()->getConfig()->getBool(
@@ -169,31 +175,82 @@ void HostFiles::read(S2EExecutionState *state)
         return;
     }
 
-    if(count > 1024*64) {
-        s2e()->getWarningsStream(state)
-            << "ERROR: count passed to HostFiles is too big" << '\n';
+    if(guestFd >= m_openFiles.size() || m_openFiles[guestFd] == -1) {
         return;
     }
 
-    if(guestFd > m_openFiles.size() || m_openFiles[guestFd] == -1) {
+    /* A zero-length read succeeds without touching the buffer */
+    if (count == 0) {
+        ret = 0;
+        state->writeCpuRegisterConcrete(CPU_OFFSET(HOSTFILES_RETURN), &ret, CPU_REG_SIZE);
         return;
     }
 
-    int fd = m_openFiles[guestFd];
-    char buf[count];
-
-    read_ret = ::read(fd, buf, count);
-    if(-1 == read_ret)
-        return;
-    ret = read_ret;
+    /* Translate the guest buffer up front, so that nothing is consumed
+       from the file if the guest did not map it. The transfer stops at
+       the first page that is not backed by RAM. */
+    std::vector<uint64_t> hostPages;
+    uint64_t mapped = 0;
+    while (mapped < count) {
+        uint64_t hostAddress = state->getHostAddress(bufAddr + mapped);
+        if (hostAddress == (uint64_t) -1 ||
+                !state->isRamRegistered(hostAddress)) {
+            break;
+        }
+        hostPages.push_back(hostAddress & TARGET_PAGE_MASK);
+        mapped += TARGET_PAGE_SIZE - ((bufAddr + mapped) & ~TARGET_PAGE_MASK);
+    }
 
-    ok = state->writeMemoryConcrete(bufAddr, buf, ret);
-    if(!ok) {
+    if (hostPages.empty()) {
         s2e()->getWarningsStream(state)
             << "ERROR: HostFiles can not write to guest buffer\n";
         return;
     }
 
+    if (mapped > count) {
+        mapped = count;
+    }
+
+    if (m_buffer.empty()) {
+        m_buffer.resize(HOSTFILES_CHUNK_SIZE);
+    }
+
+    int fd = m_openFiles[guestFd];
+    uint64_t transferred = 0;
+    while (transferred < mapped) {
+        size_t chunk = std::min<uint64_t>(mapped - transferred, m_buffer.size());
+
+        read_ret = ::read(fd, &m_buffer[0], chunk);
+        if (read_ret == -1) {
+            if (transferred == 0) {
+                return;
+            }
+            break;
+        }
+
+        /* Copy the chunk into the RAM objects one guest page at a time.
+           dmaWrite stores concrete bytes straight into the object's
+           concrete buffer instead of going through writeMemory. */
+        for (ssize_t done = 0; done < read_ret; ) {
+            uint64_t address = bufAddr + transferred;
+            uint64_t offset = address & ~TARGET_PAGE_MASK;
+            uint64_t index = ((bufAddr & ~TARGET_PAGE_MASK) + transferred)
+                             / TARGET_PAGE_SIZE;
+            unsigned length = std::min<uint64_t>(TARGET_PAGE_SIZE - offset,
+                                                 read_ret - done);
+
+            state->dmaWrite(hostPages[index] | offset,
+                            (uint8_t*) &m_buffer[done], length);
+            done += length;
+            transferred += length;
+        }
+
+        if ((size_t) read_ret < chunk) {
+            break;
+        }
+    }
+
+    ret = transferred;
     state->writeCpuRegisterConcrete(CPU_OFFSET(HOSTFILES_RETURN), &ret, CPU_REG_SIZE);
 }
 
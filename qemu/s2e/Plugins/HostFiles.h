@@ -41,6 +41,7 @@
 #include <s2e/S2EExecutionState.h>
 #include <set>
 #include <string>
+#include <vector>
 
 #ifdef TARGET_I386
 
@@ -79,6 +80,7 @@ private:
     //bool m_allowWrite;
     std::vector<std::string> m_baseDirectories;
     std::vector<int> m_openFiles;
+    std::vector<uint8_t> m_buffer;
 
     void open(S2EExecutionState *state);
     void close(S2EExecutionState *state);
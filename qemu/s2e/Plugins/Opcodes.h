@@ -52,6 +52,8 @@
 #define STATE_MANAGER_OPCODE 0xAD
 #define CODE_SELECTOR_OPCODE 0xAE
 #define MODULE_EXECUTION_DETECTOR_OPCODE 0xAF
+#define SEED_BATCH_OPCODE 0xB0
+#define FORK_SERVER_OPCODE 0xB1
 #define HOSTFILES_OPCODE 0xEE
 
 #ifdef TARGET_I386
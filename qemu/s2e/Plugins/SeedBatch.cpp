@@ -0,0 +1,320 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+extern "C" {
+#include "config.h"
+#include "qemu-common.h"
+}
+
+#include "SeedBatch.h"
+#include <s2e/S2E.h>
+#include <s2e/S2EExecutor.h>
+#include <s2e/ConfigFile.h>
+#include <s2e/Utils.h>
+#include <s2e/s2e_qemu.h>
+#include <s2e/Plugins/Opcodes.h>
+
+#include <klee/util/PathHash.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/system_error.h>
+
+extern llvm::cl::opt<bool> ConcolicMode;
+
+namespace s2e {
+namespace plugins {
+
+S2E_DEFINE_PLUGIN(SeedBatch, "Runs a corpus of seeds from a concolic snapshot", "",);
+
+static uint64_t hashSeed(const std::vector<unsigned char> &data)
+{
+    uint64_t hash = klee::hash64(data.size());
+    foreach2(it, data.begin(), data.end()) {
+        hash = klee::hash64(*it, hash);
+    }
+    return hash;
+}
+
+void SeedBatch::initialize()
+{
+    ConfigFile *cfg = s2e()->getConfig();
+    bool ok;
+
+    if (!ConcolicMode) {
+        s2e()->getWarningsStream() << "SeedBatch requires concolic mode\n";
+        exit(-1);
+    }
+
+    std::string directory = cfg->getString(getConfigKey() + ".seedDirectory", "", &ok);
+    if (!ok) {
+        s2e()->getWarningsStream() << "SeedBatch: must specify seedDirectory\n";
+        exit(-1);
+    }
+
+    llvm::error_code ec;
+    for (llvm::sys::fs::directory_iterator it(directory, ec), ie;
+         it != ie && !ec; it.increment(ec)) {
+        bool regular = false;
+        if (!llvm::sys::fs::is_regular_file(it->path(), regular) && regular) {
+            m_seedFiles.push_back(it->path());
+        }
+    }
+
+    if (ec || m_seedFiles.empty()) {
+        s2e()->getWarningsStream() << "SeedBatch: could not find any seed in "
+                                   << directory << '\n';
+        exit(-1);
+    }
+
+    std::sort(m_seedFiles.begin(), m_seedFiles.end());
+
+    m_batchSize = cfg->getInt(getConfigKey() + ".batchSize", 8);
+    if (m_batchSize == 0) {
+        m_batchSize = 1;
+    }
+
+    m_nextSeed = 0;
+    m_snapshot = NULL;
+    m_array = NULL;
+    m_seedsRun = m_seedsSkipped = m_alternatesDropped = 0;
+
+    s2e()->getMessagesStream() << "SeedBatch: loaded " << m_seedFiles.size()
+                               << " seed files from " << directory << '\n';
+
+    s2e()->getCorePlugin()->onCustomInstruction.connect(
+            sigc::mem_fun(*this, &SeedBatch::onCustomInstruction));
+    s2e()->getCorePlugin()->onStateFork.connect(
+            sigc::mem_fun(*this, &SeedBatch::onStateFork));
+    s2e()->getCorePlugin()->onStateKill.connect(
+            sigc::mem_fun(*this, &SeedBatch::onStateKill));
+}
+
+/** Read a seed file, truncating or zero-padding it to size bytes */
+bool SeedBatch::readSeed(unsigned index, unsigned size,
+                         std::vector<unsigned char> &data)
+{
+    std::ifstream file(m_seedFiles[index].c_str(), std::ios::binary);
+    if (!file) {
+        s2e()->getWarningsStream() << "SeedBatch: could not open "
+                                   << m_seedFiles[index] << '\n';
+        return false;
+    }
+
+    data.assign(size, 0);
+    if (size) {
+        file.read((char*) &data[0], size);
+    }
+    return true;
+}
+
+void SeedBatch::runBatch(S2EExecutionState *state)
+{
+    std::vector<std::vector<unsigned char> > seeds;
+    while (seeds.size() < m_batchSize && m_nextSeed < m_seedFiles.size()) {
+        std::vector<unsigned char> data;
+        if (!readSeed(m_nextSeed++, m_array->size, data)) {
+            continue;
+        }
+
+        if (!m_seedHashes.insert(hashSeed(data)).second) {
+            ++m_seedsSkipped;
+            continue;
+        }
+        seeds.push_back(data);
+    }
+
+    bool last = m_nextSeed == m_seedFiles.size();
+
+    if (seeds.empty()) {
+        m_snapshot = NULL;
+        s2e()->getExecutor()->terminateStateEarly(*state,
+                "SeedBatch: all seeds were run");
+        return;
+    }
+
+    /* The last batch runs its last seed in the snapshot itself */
+    std::vector<S2EExecutionState*> seedStates;
+    unsigned cloneCount = last ? seeds.size() - 1 : seeds.size();
+    if (cloneCount) {
+        s2e()->getExecutor()->cloneState(state, cloneCount, seedStates);
+    }
+    if (last) {
+        seedStates.push_back(state);
+    }
+
+    for (unsigned i = 0; i < seedStates.size(); ++i) {
+        seedStates[i]->concolics.bindings[m_array] = seeds[i];
+        m_seedStates[seedStates[i]] = 0;
+    }
+    m_seedsRun += seeds.size();
+
+    s2e()->getMessagesStream(state) << "SeedBatch: running " << seeds.size()
+            << " seeds (" << m_seedsRun << " run, " << m_seedsSkipped
+            << " duplicate seeds, " << m_alternatesDropped
+            << " duplicate alternate branches so far)\n";
+
+    if (last) {
+        m_snapshot = NULL;
+        return;
+    }
+
+    /* Park the snapshot with its program counter on the custom instruction,
+       so that resuming it spawns the next batch. */
+    bool result = s2e()->getExecutor()->suspendState(state);
+    assert(result && "Searcher required to use SeedBatch");
+    (void) result;
+
+    state->writeCpuState(CPU_OFFSET(exception_index), EXCP_S2E, 8*sizeof(int));
+    throw CpuExitException();
+}
+
+void SeedBatch::onCustomInstruction(S2EExecutionState *state, uint64_t opcode)
+{
+    if (!OPCODE_CHECK(opcode, SEED_BATCH_OPCODE)) {
+        return;
+    }
+
+    uint8_t op = OPCODE_GETSUBFUNCTION(opcode);
+    if (op != 0) {
+        s2e()->getWarningsStream(state)
+                << "Invalid SeedBatch opcode " << hexval(op) << '\n';
+        return;
+    }
+
+    if (m_snapshot ? state != m_snapshot : m_array != NULL) {
+        s2e()->getWarningsStream(state)
+                << "SeedBatch: the seed corpus was already used\n";
+        return;
+    }
+
+    /* Cloning the state requires it to run in KLEE */
+    state->jumpToSymbolicCpp();
+
+    if (!m_snapshot) {
+        target_ulong address, size, name;
+        bool ok = true;
+        ok &= state->readCpuRegisterConcrete(CPU_OFFSET(SEEDBATCH_BUFFER),
+                                             &address, CPU_REG_SIZE);
+        ok &= state->readCpuRegisterConcrete(CPU_OFFSET(SEEDBATCH_SIZE),
+                                             &size, CPU_REG_SIZE);
+        ok &= state->readCpuRegisterConcrete(CPU_OFFSET(SEEDBATCH_NAME),
+                                             &name, CPU_REG_SIZE);
+
+        if (!ok) {
+            s2e()->getWarningsStream(state)
+                << "ERROR: symbolic argument was passed to s2e_op SeedBatch\n";
+            return;
+        }
+
+        std::string nameStr = "seed";
+        if (name && !state->readString(name, nameStr)) {
+            s2e()->getWarningsStream(state)
+                    << "Error reading string from the guest\n";
+        }
+
+        std::vector<unsigned char> concreteData(size, 0);
+        std::vector<klee::ref<klee::Expr> > symb =
+                state->createConcolicArray(nameStr, size, concreteData);
+        m_array = state->symbolics.back().second;
+
+        for (unsigned i = 0; i < size; ++i) {
+            if (!state->writeMemory8(address + i, symb[i])) {
+                s2e()->getWarningsStream(state)
+                    << "Can not insert symbolic value"
+                    << " at " << hexval(address + i)
+                    << ": can not write to memory\n";
+            }
+        }
+
+        m_snapshot = state;
+    }
+
+    runBatch(state);
+}
+
+/**
+ *  Concolic execution of a seed harvests the untaken side of every
+ *  symbolic branch as a new state. Two seeds that follow the same
+ *  branches up to a point harvest the same alternate there, so the
+ *  alternate is only kept for the first seed that reaches that prefix.
+ */
+void SeedBatch::onStateFork(S2EExecutionState *state,
+                            const std::vector<S2EExecutionState*> &newStates,
+                            const std::vector<klee::ref<klee::Expr> > &newConditions)
+{
+    PathHashes::iterator it = m_seedStates.find(state);
+    if (it == m_seedStates.end() || newStates.size() != 2) {
+        return;
+    }
+
+    uint64_t prefix = klee::hash64(state->getPc(), it->second);
+    prefix = klee::hash64(newConditions[0]->hash(), prefix);
+
+    bool taken = newStates[0] == state;
+    it->second = klee::hash64(taken, prefix);
+
+    /* The alternate was just created and is not scheduled yet */
+    if (!m_harvested.insert(prefix).second) {
+        ++m_alternatesDropped;
+        s2e()->getExecutor()->terminateStateAtSwitch(
+                taken ? newStates[1] : newStates[0],
+                "SeedBatch: alternate branch already harvested by another seed");
+    }
+}
+
+void SeedBatch::onStateKill(S2EExecutionState *state)
+{
+    if (state == m_snapshot) {
+        m_snapshot = NULL;
+        return;
+    }
+
+    if (!m_seedStates.erase(state)) {
+        return;
+    }
+
+    if (m_seedStates.empty() && m_snapshot) {
+        s2e()->getMessagesStream(state) << "SeedBatch: batch finished, resuming state "
+                                        << m_snapshot->getID() << '\n';
+        s2e()->getExecutor()->resumeState(m_snapshot);
+    }
+}
+
+} // namespace plugins
+} // namespace s2e
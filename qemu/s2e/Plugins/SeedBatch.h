@@ -0,0 +1,126 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_PLUGINS_SEEDBATCH_H
+#define S2E_PLUGINS_SEEDBATCH_H
+
+#include <s2e/Plugin.h>
+#include <s2e/Plugins/CorePlugin.h>
+#include <s2e/S2EExecutionState.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#ifdef TARGET_I386
+
+#define SEEDBATCH_BUFFER regs[R_EAX]
+#define SEEDBATCH_SIZE regs[R_EBX]
+#define SEEDBATCH_NAME regs[R_ECX]
+
+#elif TARGET_ARM
+
+#define SEEDBATCH_BUFFER regs[0]
+#define SEEDBATCH_SIZE regs[1]
+#define SEEDBATCH_NAME regs[2]
+
+#endif
+
+namespace s2e {
+namespace plugins {
+
+/**
+ *  Runs a corpus of seed files through the same concolic buffer.
+ *
+ *  The state that issues the custom instruction becomes a snapshot: it is
+ *  cloned once per seed of the current batch, each clone getting one seed
+ *  as its concolic assignment, and is then suspended with its program
+ *  counter still on the custom instruction. When every seed state of the
+ *  batch has terminated, the snapshot is resumed, executes the instruction
+ *  again and spawns the next batch. A seed therefore costs a state copy
+ *  instead of a guest restart.
+ *
+ *  The alternate branches that concolic execution harvests along each
+ *  seed path are deduplicated by a hash of the branch decisions leading to
+ *  them, so that seeds sharing a path prefix do not explore it twice.
+ */
+class SeedBatch : public Plugin
+{
+    S2E_PLUGIN
+public:
+    SeedBatch(S2E* s2e): Plugin(s2e) {}
+
+    void initialize();
+
+private:
+    typedef std::map<S2EExecutionState*, uint64_t> PathHashes;
+
+    std::vector<std::string> m_seedFiles;
+    unsigned m_nextSeed;
+    unsigned m_batchSize;
+
+    /** Hashes of the seeds already run, to skip identical files */
+    std::set<uint64_t> m_seedHashes;
+
+    /** State parked on the custom instruction, if any */
+    S2EExecutionState *m_snapshot;
+    const klee::Array *m_array;
+
+    /** Seed states of the current batch with their path hash */
+    PathHashes m_seedStates;
+
+    /** Path prefixes whose alternate branch was already harvested */
+    std::set<uint64_t> m_harvested;
+
+    unsigned m_seedsRun;
+    unsigned m_seedsSkipped;
+    unsigned m_alternatesDropped;
+
+    bool readSeed(unsigned index, unsigned size,
+                  std::vector<unsigned char> &data);
+    void runBatch(S2EExecutionState *state);
+
+    void onCustomInstruction(S2EExecutionState* state, uint64_t opcode);
+    void onStateFork(S2EExecutionState *state,
+                     const std::vector<S2EExecutionState*> &newStates,
+                     const std::vector<klee::ref<klee::Expr> > &newConditions);
+    void onStateKill(S2EExecutionState *state);
+};
+
+} // namespace plugins
+} // namespace s2e
+
+#endif // S2E_PLUGINS_SEEDBATCH_H
@@ -283,6 +283,8 @@ void S2E::writeBitCodeToFile()
 
 S2E::~S2E()
 {
+    m_corePlugin->onEngineShutdown.emit();
+
     //Delete all the stuff used by the instance
     foreach(Plugin* p, m_activePluginsList)
         delete p;
@@ -683,31 +685,57 @@ int S2E::fork()
         //And the solver output
         m_s2eExecutor->initializeSolver();
 
-        m_forking = true;
+        restartForkedQemu();
+    }
 
-        qemu_init_cpu_loop();
-        if (main_loop_init()) {
-            fprintf(stderr, "qemu_init_main_loop failed\n");
-            exit(1);
-        }
+    return pid == 0 ? 1 : 0;
+#endif
+}
 
-        if (init_timer_alarm(0)<0) {
-            getDebugStream() << "Could not initialize timers" << '\n';
-            exit(-1);
-        }
+/** Fork without registering the child as a new S2E instance.
+    The child shares the output directory of its parent and is not
+    counted in the process limit. Returns the pid of the child in the
+    parent, 0 in the child and -1 on failure. */
+int S2E::forkSnapshot()
+{
+#ifdef CONFIG_WIN32
+    return -1;
+#else
+    pid_t pid = ::fork();
+    if (pid == 0) {
+        restartForkedQemu();
+    }
+    return pid;
+#endif
+}
+
+/** Recreate the threads and timers of QEMU, which are not inherited
+    by a forked process. The VM is left stopped. */
+void S2E::restartForkedQemu()
+{
+#ifndef CONFIG_WIN32
+    m_forking = true;
 
-        qemu_init_vcpu(env);
-        cpu_synchronize_all_post_init();
-        os_setup_signal_handling();
-        vm_start();
-        os_setup_post();
-        resume_all_vcpus();
-        vm_stop(RUN_STATE_SAVE_VM);
+    qemu_init_cpu_loop();
+    if (main_loop_init()) {
+        fprintf(stderr, "qemu_init_main_loop failed\n");
+        exit(1);
+    }
 
-        m_forking = false;
+    if (init_timer_alarm(0)<0) {
+        getDebugStream() << "Could not initialize timers" << '\n';
+        exit(-1);
     }
 
-    return pid == 0 ? 1 : 0;
+    qemu_init_vcpu(env);
+    cpu_synchronize_all_post_init();
+    os_setup_signal_handling();
+    vm_start();
+    os_setup_post();
+    resume_all_vcpus();
+    vm_stop(RUN_STATE_SAVE_VM);
+
+    m_forking = false;
 #endif
 }
 
@@ -139,6 +139,8 @@ protected:
     /* forked indicates whether the current S2E process was forked from a parent S2E process */
     void initOutputDirectory(const std::string& outputDirectory, int verbose, bool forked);
 
+    void restartForkedQemu();
+
     void initKleeOptions();
     void initExecutor();
     void initPlugins();
@@ -214,6 +216,7 @@ public:
     void writeBitCodeToFile();
 
     int fork();
+    int forkSnapshot();
     bool isForking() const {
         return m_forking;
     }
@@ -59,6 +59,7 @@ extern CPUArchState *env;
 #include <s2e/S2EDeviceState.h>
 #include <s2e/S2EExecutor.h>
 #include <s2e/Plugin.h>
+#include <s2e/Plugins/CorePlugin.h>
 #include <s2e/Utils.h>
 
 #include <klee/Context.h>
@@ -106,13 +107,17 @@ S2EExecutionState::S2EExecutionState(klee::KFunction *kf) :
         m_symbexEnabled(true), m_startSymbexAtPC((uint64_t) -1),
         m_active(true), m_zombie(false), m_yielded(false), m_runningConcrete(true),
         m_cpuRegistersObject(NULL), m_cpuSystemObject(NULL),
+        m_symbolicRegistersMask(0), m_symbolicRegistersMaskStamp(0),
         m_deviceState(this),
         m_qemuIcount(0),
         m_lastS2ETb(NULL),
         m_lastMergeICount((uint64_t)-1),
         m_needFinalizeTBExec(false),
         m_forkAborted(false),
+        m_branching(false),
         m_nextSymbVarId(0),
+        m_pathHash(0), m_pathDepth(0), m_replayNode(NULL),
+        m_logConstraints(false),
         m_runningExceptionEmulationCode(false)
 {
     //XXX: make this a struct, not a pointer...
@@ -277,12 +282,6 @@ void S2EExecutionState::addressSpaceChange(const klee::MemoryObject *mo,
         m_cpuRegistersObject = newState;
     } else if (mo == m_cpuSystemState) {
         m_cpuSystemObject = newState;
-    } else {
-        ObjectPair op = m_memcache.get(mo->address);
-        if (op.first) {
-            op.second = newState;
-            m_memcache.put(mo->address, op);
-        }
     }
 }
 
@@ -849,6 +848,21 @@ uint64_t S2EExecutionState::getPid() const
 }
 
 uint64_t S2EExecutionState::getSymbolicRegistersMask() const
+{
+    const ObjectState* os = m_cpuRegistersObject;
+
+    /* The mask only changes when some byte of the register object
+       switches between concrete and symbolic, which is rare compared
+       to the number of times this is called (once per TB). */
+    if(os->getConcreteMaskStamp() == m_symbolicRegistersMaskStamp)
+        return m_symbolicRegistersMask;
+
+    m_symbolicRegistersMaskStamp = os->getConcreteMaskStamp();
+    m_symbolicRegistersMask = computeSymbolicRegistersMask();
+    return m_symbolicRegistersMask;
+}
+
+uint64_t S2EExecutionState::computeSymbolicRegistersMask() const
 {
     const ObjectState* os = m_cpuRegistersObject;
     if(os->isAllConcrete())
@@ -1045,11 +1059,7 @@ ref<Expr> S2EExecutionState::readMemory(uint64_t address,
         if(hostAddress == (uint64_t) -1)
             return ref<Expr>(0);
 
-        ObjectPair op = m_memcache.get(hostAddress & S2E_RAM_OBJECT_MASK);
-        if (!op.first) {
-            op = addressSpace.findObject(hostAddress & S2E_RAM_OBJECT_MASK);
-            m_memcache.put(hostAddress & S2E_RAM_OBJECT_MASK, op);
-        }
+        ObjectPair op = addressSpace.findObject(hostAddress & S2E_RAM_OBJECT_MASK);
 
         assert(op.first && op.first->isUserSpecified
                && op.first->size == S2E_RAM_OBJECT_SIZE);
@@ -1254,29 +1264,22 @@ void S2EExecutionState::readRamConcreteCheck(uint64_t hostAddress, uint8_t* buf,
 
         uint64_t page_addr = hostAddress & S2E_RAM_OBJECT_MASK;
 
-        //ObjectPair op = addressSpace.findObject(page_addr);
-        ObjectPair op = m_memcache.get(page_addr);
-        if (!op.first) {
-            op = addressSpace.findObject(page_addr);
-            m_memcache.put(page_addr, op);
-        }
+        ObjectPair op = addressSpace.findObject(page_addr);
 
 
         assert(op.first && op.first->isUserSpecified &&
                op.first->address == page_addr &&
                op.first->size == S2E_RAM_OBJECT_SIZE);
 
-        for(uint64_t i=0; i<size; ++i) {
-            if(!op.second->readConcrete8(page_offset+i, buf+i)) {
-                if (PrintModeSwitch) {
-                    g_s2e->getMessagesStream()
-                            << "Switching to KLEE executor at pc = "
-                            << hexval(getPc()) << '\n';
-                }
-                m_startSymbexAtPC = getPc();
-                // XXX: what about regs_to_env ?
-                s2e_longjmp(env->jmp_env, 1);
+        if(!op.second->readConcrete(page_offset, buf, size)) {
+            if (PrintModeSwitch) {
+                g_s2e->getMessagesStream()
+                        << "Switching to KLEE executor at pc = "
+                        << hexval(getPc()) << '\n';
             }
+            m_startSymbexAtPC = getPc();
+            // XXX: what about regs_to_env ?
+            s2e_longjmp(env->jmp_env, 1);
         }
     } else {
         /* Access spans multiple MemoryObject's */
@@ -1295,18 +1298,17 @@ void S2EExecutionState::readRamConcrete(uint64_t hostAddress, uint8_t* buf, uint
 
         uint64_t page_addr = hostAddress & S2E_RAM_OBJECT_MASK;
 
-        //ObjectPair op = addressSpace.findObject(page_addr);
-        ObjectPair op = m_memcache.get(page_addr);
-        if (!op.first) {
-            op = addressSpace.findObject(page_addr);
-            m_memcache.put(page_addr, op);
-        }
+        ObjectPair op = addressSpace.findObject(page_addr);
 
 
         assert(op.first && op.first->isUserSpecified &&
                op.first->address == page_addr &&
                op.first->size == S2E_RAM_OBJECT_SIZE);
 
+        if(op.second->readConcrete(page_offset, buf, size)) {
+            return;
+        }
+
         ObjectState *wos = NULL;
         for(uint64_t i=0; i<size; ++i) {
             if(!op.second->readConcrete8(page_offset+i, buf+i)) {
@@ -1337,12 +1339,7 @@ void S2EExecutionState::writeRamConcrete(uint64_t hostAddress, const uint8_t* bu
         uint64_t page_addr = hostAddress & S2E_RAM_OBJECT_MASK;
 
 
-        //ObjectPair op = addressSpace.findObject(page_addr);
-        ObjectPair op = m_memcache.get(page_addr);
-        if (!op.first) {
-            op = addressSpace.findObject(page_addr);
-            m_memcache.put(page_addr, op);
-        }
+        ObjectPair op = addressSpace.findObject(page_addr);
 
         assert(op.first && op.first->isUserSpecified &&
                op.first->address == page_addr &&
@@ -1806,6 +1803,31 @@ bool S2EExecutionState::merge(const ExecutionState &_b)
         return false;
     }
 
+    // RAM objects are not in the object map, only visit those that differ
+    std::vector<std::pair<const ObjectState*, const ObjectState*> > ramChanges;
+    addressSpace.getChangedRamObjects(b.addressSpace, ramChanges);
+    for(unsigned i = 0; i < ramChanges.size(); ++i) {
+        const ObjectState *aos = ramChanges[i].first;
+        const ObjectState *bos = ramChanges[i].second;
+        if(!aos || !bos) {
+            if(DebugLogStateMerge)
+                s << "merge failed: different RAM bindings" << '\n';
+            return false;
+        }
+        const MemoryObject *mo = aos->getObject();
+        if(mo->isValueIgnored)
+            continue;
+        if(DebugLogStateMerge)
+            s << "\t\tmutated: " << mo->id << " (" << mo->name << ")\n";
+        if(mo->isSharedConcrete) {
+            if(DebugLogStateMerge)
+                s << "merge failed: different shared-concrete objects "
+                  << '\n';
+            return false;
+        }
+        mutated.insert(mo);
+    }
+
     // Create state predicates
     ref<Expr> inA = ConstantExpr::alloc(1, Expr::Bool);
     ref<Expr> inB = ConstantExpr::alloc(1, Expr::Bool);
@@ -1877,6 +1899,13 @@ bool S2EExecutionState::merge(const ExecutionState &_b)
 
     constraints.addConstraint(OrExpr::create(inA, inB));
 
+    /* The branches logged so far were taken on paths that no longer
+       match the constraints of the merged state */
+    if (m_logConstraints) {
+        m_branchLog.clear();
+        m_constraintLog.assign(constraints.begin(), constraints.end());
+    }
+
     // Merge dirty mask by clearing bits that differ. Clearning bits in
     // dirty mask can only affect performance but not correcntess.
     // NOTE: this requires flushing TLB
@@ -1929,11 +1958,7 @@ void S2EExecutionState::dmaRead(uint64_t hostAddress, uint8_t *buf, unsigned siz
             length = size;
         }
 
-        ObjectPair op = m_memcache.get(hostPage);
-        if (!op.first) {
-            op = addressSpace.findObject(hostPage);
-            m_memcache.put(hostAddress, op);
-        }
+        ObjectPair op = addressSpace.findObject(hostPage);
         assert(op.first && op.second && op.first->address == hostPage);
         ObjectState *os = const_cast<ObjectState*>(op.second);
         uint8_t *concreteStore;
@@ -1970,11 +1995,7 @@ void S2EExecutionState::dmaWrite(uint64_t hostAddress, uint8_t *buf, unsigned si
         }
 
 
-        ObjectPair op = m_memcache.get(hostPage);
-        if (!op.first) {
-            op = addressSpace.findObject(hostPage);
-            m_memcache.put(hostAddress, op);
-        }
+        ObjectPair op = addressSpace.findObject(hostPage);
 
         assert(op.first && op.second && op.first->address == hostPage);
         ObjectState *os = addressSpace.getWriteable(op.first, op.second);
@@ -2048,21 +2069,12 @@ void S2EExecutionState::updateTlbEntry(CPUArchState* env,
     assert( (hostAddr & ~TARGET_PAGE_MASK) == 0 );
     assert( (virtAddr & ~TARGET_PAGE_MASK) == 0 );
 
-    ObjectPair *ops = m_memcache.getArray(hostAddr);
-
     unsigned int index = (virtAddr >> S2E_RAM_OBJECT_BITS) & (CPU_S2E_TLB_SIZE - 1);
     for(int i = 0; i < CPU_S2E_TLB_SIZE / CPU_TLB_SIZE; ++i) {
         S2ETLBEntry* entry = &env->s2e_tlb_table[mmu_idx][index];
         ObjectState *oldObjectState = static_cast<ObjectState *>(entry->objectState);
 
-        ObjectPair op;
-
-        if (!ops || !(op = ops[i]).first) {
-            op = m_memcache.get(hostAddr);
-            if (!op.first) {
-                op = addressSpace.findObject(hostAddr);
-            }
-        }
+        ObjectPair op = addressSpace.findObject(hostAddr);
         assert(op.first && op.second && op.second->getObject() == op.first && op.first->address == hostAddr);
 
         klee::ObjectState *ros = const_cast<ObjectState*>(op.second);
@@ -2079,12 +2091,6 @@ void S2EExecutionState::updateTlbEntry(CPUArchState* env,
 
         op = ObjectPair(op.first, (const ObjectState*)entry->objectState);
 
-        if (!ops) {
-            m_memcache.put(hostAddr, op);
-            ops = m_memcache.getArray(hostAddr & TARGET_PAGE_MASK);
-        }
-        ops[i] = op;
-
 
         /* Store the new mapping in the cache */
 #ifdef S2E_DEBUG_TLBCACHE
@@ -2140,6 +2146,12 @@ void S2EExecutionState::addConstraint(klee::ref<klee::Expr> e)
         assert(res && !truth  &&  "state has invalid constraint set");
     }
 
+    g_s2e->getCorePlugin()->onConstraintAdded.emit(this, e, m_branching);
+
+    if (m_logConstraints) {
+        m_constraintLog.push_back(e);
+    }
+
     constraints.addConstraint(e);
 }
 
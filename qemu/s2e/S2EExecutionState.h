@@ -41,7 +41,6 @@
 #include <cpu.h>
 #include "S2EDeviceState.h"
 #include "S2EStatsTracker.h"
-#include "MemoryCache.h"
 #include "s2e_config.h"
 
 /** S2E_TARGET_CONC_LIMIT defines the border between concrete and symbolic area.
@@ -85,16 +84,90 @@ class PluginState;
 class S2EDeviceState;
 class S2EExecutionState;
 struct S2ETranslationBlock;
+struct ReplayNode;
+
+/** One fork decision: the state forked at pc and became its index-th
+    outcome. A node is shared by all the states that went through the
+    decision and only references its parent, so the nodes of all states
+    form a tree (see S2EExecutor::writeCheckpoint). */
+struct PathNode
+{
+    unsigned refCount;
+    PathNode *parent;
+    uint64_t pc;
+    unsigned index;
+
+    /** Identifier of the node in the checkpoint file, valid if the node
+        was written in the current checkpoint generation */
+    uint64_t id;
+    unsigned generation;
+
+    PathNode(PathNode *_parent, uint64_t _pc, unsigned _index)
+        : refCount(0), parent(_parent), pc(_pc), index(_index),
+          id(0), generation(0) {
+        if (parent) {
+            ++parent->refCount;
+        }
+    }
+};
+
+/** Reference to a PathNode. Releasing a long chain of nodes does not
+    recurse. */
+class PathNodeRef
+{
+    PathNode *m_node;
+
+    void inc() {
+        if (m_node) {
+            ++m_node->refCount;
+        }
+    }
+
+    static void release(PathNode *node) {
+        while (node && --node->refCount == 0) {
+            PathNode *parent = node->parent;
+            delete node;
+            node = parent;
+        }
+    }
+
+public:
+    PathNodeRef() : m_node(NULL) {}
+    explicit PathNodeRef(PathNode *node) : m_node(node) { inc(); }
+    PathNodeRef(const PathNodeRef &ref) : m_node(ref.m_node) { inc(); }
+    ~PathNodeRef() { release(m_node); }
+
+    PathNodeRef &operator=(const PathNodeRef &ref) {
+        PathNode *old = m_node;
+        m_node = ref.m_node;
+        inc();
+        release(old);
+        return *this;
+    }
+
+    PathNode *get() const { return m_node; }
+};
+
+/** Branch met by a generational concolic path (see S2EExecutor::fork).
+    The path evaluated condition to taken, after its first constraints
+    path constraints. */
+struct LoggedBranch
+{
+    uint64_t pc;
+    unsigned constraints; /* length of the prefix in m_constraintLog */
+    klee::ref<klee::Expr> condition;
+    bool taken;
+
+    LoggedBranch(uint64_t _pc, unsigned _constraints,
+                 const klee::ref<klee::Expr> &_condition, bool _taken)
+        : pc(_pc), constraints(_constraints), condition(_condition),
+          taken(_taken) {}
+};
 
 //typedef std::tr1::unordered_map<const Plugin*, PluginState*> PluginStateMap;
 typedef std::map<const Plugin*, PluginState*> PluginStateMap;
 typedef PluginState* (*PluginStateFactory)(Plugin *p, S2EExecutionState *s);
 
-typedef MemoryCachePool<klee::ObjectPair,
-                S2E_RAM_OBJECT_BITS,
-                TARGET_PAGE_BITS,
-                S2E_MEMCACHE_SUPERPAGE_BITS> S2EMemoryCache;
-
 struct S2EPhysCacheEntry
 {
     uint64_t hostPage;
@@ -158,13 +231,16 @@ protected:
     klee::ObjectState *m_cpuRegistersObject;
     klee::ObjectState *m_cpuSystemObject;
 
+    /* Result of getSymbolicRegistersMask() for the concreteness of
+       m_cpuRegistersObject identified by m_symbolicRegistersMaskStamp */
+    mutable uint64_t m_symbolicRegistersMask;
+    mutable uint64_t m_symbolicRegistersMaskStamp;
+
     static klee::MemoryObject* m_dirtyMask;
     klee::ObjectState *m_dirtyMaskObject;
 
     S2EDeviceState m_deviceState;
 
-    mutable S2EMemoryCache m_memcache;
-
     /* The following structure is used to store QEMU time accounting
        variables while the state is inactive */
     TimersState* m_timersState;
@@ -178,8 +254,34 @@ protected:
 
     bool m_forkAborted;
 
+    /** Set while S2EExecutor adds the constraint of a branch direction,
+        reported to onConstraintAdded */
+    bool m_branching;
+
     unsigned m_nextSymbVarId;
 
+    /** Rolling hash of the branch decisions taken along the path, and
+        the number of decisions folded into it (see S2EExecutor::fork) */
+    uint64_t m_pathHash;
+    unsigned m_pathDepth;
+
+    /** Last fork decision of the state, recorded for checkpoints */
+    PathNodeRef m_pathNode;
+
+    /** Position of the state in the checkpoint being replayed, NULL
+        once the state leaves the recorded paths */
+    ReplayNode *m_replayNode;
+
+    /** Branches whose negation is solved when the state terminates */
+    std::vector<LoggedBranch> m_branchLog;
+
+    /** Path constraints in the order they were added, when
+        m_logConstraints is set. Unlike the constraint manager, which
+        rewrites and drops constraints as they are simplified, the
+        prefix of a logged branch stays valid in this list. */
+    std::vector<klee::ref<klee::Expr> > m_constraintLog;
+    bool m_logConstraints;
+
     S2EStateStats m_stats;
 
     /**
@@ -202,6 +304,8 @@ protected:
 
     std::string getUniqueVarName(const std::string &name);
 
+    uint64_t computeSymbolicRegistersMask() const;
+
 public:
     enum AddressType {
         VirtualAddress, PhysicalAddress, HostAddress
@@ -212,6 +316,8 @@ public:
 
     int getID() const { return m_stateID; }
 
+    uint64_t getPathHash() const { return m_pathHash; }
+
     S2EDeviceState *getDeviceState() {
         return &m_deviceState;
     }
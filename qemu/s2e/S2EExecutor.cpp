@@ -85,6 +85,8 @@ uint64_t helper_set_cc_op_eflags(void);
 #include <s2e/S2EDeviceState.h>
 #include <s2e/SelectRemovalPass.h>
 #include <s2e/S2EStatsTracker.h>
+#include <s2e/SolutionFuture.h>
+#include <klee/util/PathHash.h>
 
 //XXX: Remove this from executor
 #include <s2e/Plugins/ModuleExecutionDetector.h>
@@ -103,6 +105,7 @@ uint64_t helper_set_cc_op_eflags(void);
 #include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/Process.h>
 #include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Path.h>
 
 #include <klee/PTree.h>
 #include <klee/Memory.h>
@@ -112,17 +115,32 @@ uint64_t helper_set_cc_op_eflags(void);
 #include <klee/CoreStats.h>
 #include <klee/TimerStatIncrementer.h>
 #include <klee/Solver.h>
+#include <klee/util/ExprStream.h>
+#include <klee/util/ExprUtil.h>
+#include <klee/util/Assignment.h>
 
 #include <llvm/Support/TimeValue.h>
 
 #include <vector>
+#include <map>
+#include <algorithm>
 
 #include <sstream>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <signal.h>
 
 #ifdef WIN32
 #include <windows.h>
 #else
 #include <sys/mman.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <tr1/functional>
@@ -141,17 +159,6 @@ extern "C" {
     //void* g_s2e_exec_ret_addr = 0;
 }
 
-namespace {
-    uint64_t hash64(uint64_t val, uint64_t initial = 14695981039346656037ULL) {
-        const char* __first = (const char*) &val;
-        for (unsigned int i = 0; i < sizeof(uint64_t); ++i) {
-            initial ^= static_cast<uint64_t>(*__first++);
-            initial *= static_cast<uint64_t>(1099511628211ULL);
-        }
-        return initial;
-    }
-}
-
 namespace {
     cl::opt<bool>
     UseSelectCleaner("use-select-cleaner",
@@ -170,6 +177,12 @@ namespace {
                      " disabling leads to faster but possibly incorrect execution"),
             cl::init(true));
 
+    cl::opt<bool>
+    SkipUnchangedOnStateSwitch("skip-unchanged-on-state-switch",
+            cl::desc("Do not save or restore concrete memory objects that are"
+                     " identical in the old and new states"),
+            cl::init(true));
+
     cl::opt<bool>
     KeepLLVMFunctions("keep-llvm-functions",
             cl::desc("Never delete generated LLVM functions"),
@@ -224,6 +237,78 @@ namespace {
     cl::opt<unsigned>
     ClockSlowDownFastHelpers("clock-slow-down-fast-helpers",
                    cl::desc("Slow down factor when interpreting LLVM code and using fast helpers"),  cl::init(11));
+
+    cl::opt<unsigned>
+    PathHashCheckpoint("path-hash-checkpoint",
+                   cl::desc("Every N branch decisions, terminate states whose path was "
+                            "already followed by another state of any S2E process (0 disables)"),
+                   cl::init(0));
+
+    cl::opt<unsigned>
+    CheckpointInterval("checkpoint-interval",
+                   cl::desc("Every N seconds, append the fork decisions of all live states "
+                            "to checkpoint.paths (0 disables)"),
+                   cl::init(0));
+
+    cl::opt<bool>
+    CheckpointOnSignal("checkpoint-on-signal",
+                   cl::desc("Append a checkpoint to checkpoint.paths when receiving SIGUSR2"),
+                   cl::init(false));
+
+    cl::opt<std::string>
+    ResumeCheckpoint("resume-checkpoint",
+                   cl::desc("Replay the fork decisions of the last complete checkpoint "
+                            "in the given file, terminating the states that leave them. "
+                            "The guest must reach the same forks in the same order, so "
+                            "nondeterministic inputs (time, interrupts, devices) are not "
+                            "supported and abort the resume"),
+                   cl::init(""));
+
+    cl::opt<unsigned>
+    ForkSiteBudget("fork-site-budget",
+                   cl::desc("Maximum number of forks at each guest program counter (0 means unlimited)"),
+                   cl::init(0));
+
+    cl::opt<s2e::ForkSite::Policy>
+    ForkSitePolicy("fork-site-policy",
+                   cl::desc("What to do at a site whose fork budget is exhausted"),
+                   cl::values(clEnumValN(s2e::ForkSite::STOP, "stop",
+                                         "follow one outcome without forking"),
+                              clEnumValN(s2e::ForkSite::CONCRETIZE, "concretize",
+                                         "concretize the data the condition depends on"),
+                              clEnumValEnd),
+                   cl::init(s2e::ForkSite::STOP));
+
+    cl::list<std::string>
+    ForkSiteBudgetAt("fork-site-budget-at",
+                   cl::desc("Fork budgets of individual sites, as pc:budget[:stop|concretize]"),
+                   cl::CommaSeparated);
+
+    cl::opt<bool>
+    ForkSiteStats("fork-site-stats",
+                   cl::desc("Write the fork statistics of each site to forksites.stats "
+                            "along with run.stats"),
+                   cl::init(false));
+
+    cl::opt<bool>
+    ConcolicGenerational("concolic-generational",
+                   cl::desc("Follow the concolic path without forking and log its branches. "
+                            "When the path terminates, their negations are solved into new "
+                            "seeds written to the seeds directory"),
+                   cl::init(false));
+
+    cl::opt<unsigned>
+    GenerationalSolverJobs("concolic-generational-jobs",
+                   cl::desc("Number of negated branches solved by the background solver "
+                            "processes while exploration goes on (0 solves them in the "
+                            "S2E process)"),
+                   cl::init(0));
+
+    cl::opt<unsigned>
+    SolverWorkers("solver-workers",
+                   cl::desc("Maximum number of processes solving test cases in the "
+                            "background"),
+                   cl::init(4));
 }
 
 //The logs may be flooded with messages when switching execution mode.
@@ -255,6 +340,7 @@ DebugConstraints("debug-constraints",
 
 
 extern cl::opt<bool> UseExprSimplifier;
+extern cl::opt<bool> NoPreferCex;
 
 extern "C" {
     int g_s2e_fork_on_symbolic_address = 0;
@@ -270,6 +356,82 @@ extern "C" {
 
 namespace s2e {
 
+/**
+ *  Open-addressed set of path hashes, shared by all S2E processes.
+ *  Zero marks an empty slot. Once the set is full, new hashes are not
+ *  recorded anymore and are reported as new.
+ */
+struct PathHashSet {
+    enum { Size = 1 << 20 };
+
+    unsigned count;
+    uint64_t hashes[Size];
+
+    PathHashSet() : count(0) {
+        memset(hashes, 0, sizeof(hashes));
+    }
+
+    /** Returns false if hash was already in the set */
+    bool insert(uint64_t hash) {
+        if (!hash) {
+            hash = 1;
+        }
+
+        for (unsigned i = hash & (Size - 1); ; i = (i + 1) & (Size - 1)) {
+            if (hashes[i] == hash) {
+                return false;
+            }
+            if (!hashes[i]) {
+                if (count < Size / 2) {
+                    hashes[i] = hash;
+                    ++count;
+                }
+                return true;
+            }
+        }
+    }
+};
+
+/**
+ *  Fork decisions of the checkpoint being resumed. The children of a
+ *  node are the outcomes of the fork at pc that lead to at least one
+ *  checkpointed state.
+ */
+struct ReplayNode {
+    uint64_t pc;
+    unsigned index;
+    bool target;
+    std::vector<ReplayNode*> children;
+
+    ReplayNode(uint64_t _pc, unsigned _index)
+        : pc(_pc), index(_index), target(false) {}
+
+    ReplayNode *getChild(unsigned index) const {
+        foreach2(it, children.begin(), children.end()) {
+            if ((*it)->index == index) {
+                return *it;
+            }
+        }
+        return NULL;
+    }
+};
+
+/** Fork decision as read from a checkpoint file */
+struct CheckpointNode {
+    uint64_t parent;
+    uint64_t pc;
+    unsigned index;
+};
+
+static volatile sig_atomic_t s_checkpointRequested = 0;
+
+#ifndef _WIN32
+static void s2e_checkpoint_signal_handler(int signal)
+{
+    s_checkpointRequested = 1;
+}
+#endif
+
 /* Global array to hold tb function arguments */
 volatile void* tb_function_args[3];
 
@@ -360,6 +522,8 @@ bool S2EExternalDispatcher::runProtectedCall(Function *f, uint64_t *args) {
  * This is used whenever S2E deletes a translation block and its LLVM
  * representation. Failing to do so would leave stale references to
  * machine code in KLEE's external dispatcher.
+ * The JIT code of the translation block itself (generated when
+ * running in LLVM mode) is released as well.
  */
 void S2EExternalDispatcher::removeFunction(llvm::Function *f) {
         dispatchers_ty::iterator it, itn;
@@ -380,6 +544,8 @@ void S2EExternalDispatcher::removeFunction(llvm::Function *f) {
                 ++it;
             }
         }
+
+        executionEngine->freeMachineCodeForFunction(f);
     }
 
 
@@ -621,7 +787,11 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
         : Executor(opts, ie, tcgLLVMContext->getExecutionEngine()),
           m_s2e(s2e), m_tcgLLVMContext(tcgLLVMContext),
           m_executeAlwaysKlee(false), m_forkProcTerminateCurrentState(false),
-          m_inLoadBalancing(false), yieldedState(NULL)
+          m_inLoadBalancing(false), yieldedState(NULL), m_pathHashes(NULL),
+          m_checkpointFile(NULL), m_checkpointGeneration(1),
+          m_nextCheckpointNodeId(1), m_checkpointCount(0),
+          m_lastCheckpointTime(0), m_replayRoot(NULL),
+          m_forkSiteAccounting(false), m_solverPool(NULL)
 {
     delete externalDispatcher;
     externalDispatcher = new S2EExternalDispatcher(
@@ -780,7 +950,8 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
         assert(filename);
         MOpts = ModuleOptions(vector<string>(1, filename),
                 /* Optimize= */ true, /* CheckDivZero= */ false,
-                m_tcgLLVMContext->getFunctionPassManager());
+                m_tcgLLVMContext->getFunctionPassManager(),
+                UseSelectCleaner ? "tcg-select-cleaner" : "tcg");
 
         g_free(filename);
     }
@@ -873,6 +1044,10 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
             replaceExternalFunctionsWithSpecialHandlers();
         }
 
+#ifdef TARGET_I386
+        replaceFlagsHelpersWithSpecialHandlers();
+#endif
+
         m_tcgLLVMContext->initializeHelpers();
     }
 
@@ -889,6 +1064,66 @@ S2EExecutor::S2EExecutor(S2E* s2e, TCGLLVMContext *tcgLLVMContext,
 
     concolicMode = ConcolicMode;
 
+    if (PathHashCheckpoint) {
+        m_pathHashes = new S2ESynchronizedObject<PathHashSet>();
+    }
+
+    if (CheckpointOnSignal) {
+#ifdef _WIN32
+        s2e->getWarningsStream()
+                << CheckpointOnSignal.ArgStr << " is not supported on Windows\n";
+#else
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = s2e_checkpoint_signal_handler;
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR2, &action, NULL);
+#endif
+    }
+
+    m_forkSiteAccounting = ForkSiteBudget || ForkSiteStats || !ForkSiteBudgetAt.empty();
+
+    foreach2(it, ForkSiteBudgetAt.begin(), ForkSiteBudgetAt.end()) {
+        /* The pc is unsigned and may use the whole 64 bits (e.g., x86_64
+           kernel addresses), so it is not parsed with a signed format */
+        const char *str = it->c_str();
+        char *end = NULL, *budgetEnd = NULL;
+        errno = 0;
+        uint64_t pc = isdigit((unsigned char) *str) ? strtoull(str, &end, 0) : 0;
+        unsigned long budget = 0;
+        if (end && end != str && *end == ':' && isdigit((unsigned char) end[1])) {
+            budget = strtoul(end + 1, &budgetEnd, 10);
+        }
+
+        const char *policy = budgetEnd && *budgetEnd == ':' ? budgetEnd + 1 : "";
+        if (!budgetEnd || errno || budget > UINT_MAX ||
+                (*budgetEnd && *budgetEnd != ':') ||
+                (*budgetEnd == ':' && strcmp(policy, "stop") &&
+                 strcmp(policy, "concretize"))) {
+            s2e->getWarningsStream()
+                    << "Invalid " << ForkSiteBudgetAt.ArgStr << " entry " << *it << '\n';
+            exit(-1);
+        }
+
+        ForkSite &site = getForkSite(pc);
+        site.budget = budget;
+        if (*policy) {
+            site.policy = strcmp(policy, "stop") ? ForkSite::CONCRETIZE : ForkSite::STOP;
+        }
+    }
+
+    if (ConcolicGenerational && !ConcolicMode) {
+        s2e->getWarningsStream()
+                << ConcolicGenerational.ArgStr << " requires concolic mode\n";
+        exit(-1);
+    }
+
+    if (!ResumeCheckpoint.empty() && !loadCheckpoint(ResumeCheckpoint)) {
+        s2e->getWarningsStream()
+                << "Could not resume from checkpoint " << ResumeCheckpoint << '\n';
+        exit(-1);
+    }
+
     if (UseFastHelpers) {
         if (!ForkOnSymbolicAddress) {
             s2e->getWarningsStream()
@@ -920,6 +1155,19 @@ S2EExecutor::~S2EExecutor()
 {
     if(statsTracker)
         statsTracker->done();
+
+    delete m_pathHashes;
+
+    completeSeeds(0);
+    delete m_solverPool;
+
+    if (m_checkpointFile) {
+        fclose(m_checkpointFile);
+    }
+
+    foreach2(it, m_replayNodes.begin(), m_replayNodes.end()) {
+        delete *it;
+    }
 }
 
 S2EExecutionState* S2EExecutor::createInitialState()
@@ -932,6 +1180,7 @@ S2EExecutionState* S2EExecutor::createInitialState()
 
     state->m_runningConcrete = true;
     state->m_active = true;
+    state->m_logConstraints = ConcolicGenerational;
 
     if(pathWriter)
         state->pathOS = pathWriter->open();
@@ -947,6 +1196,10 @@ S2EExecutionState* S2EExecutor::createInitialState()
     processTree = new PTree(state);
     state->ptreeNode = processTree->root;
 
+    if (m_replayRoot && !m_replayRoot->target) {
+        state->m_replayNode = m_replayRoot;
+    }
+
     /* Externally accessible global vars */
     /* XXX move away */
     addExternalObject(*state, &tcg_llvm_runtime,
@@ -1085,6 +1338,10 @@ void S2EExecutor::registerRam(S2EExecutionState *initialState,
     qemu_log("\t host_address: %"PRIx64".\n", hostAddress);
 #endif
 
+    /* RAM objects are looked up by index rather than in the object map */
+    initialState->addressSpace.registerRamRegion(hostAddress, size,
+                                                 S2E_RAM_OBJECT_BITS);
+
     for(uint64_t addr = hostAddress; addr < hostAddress+size;
                  addr += S2E_RAM_OBJECT_SIZE) {
         std::stringstream ss;
@@ -1127,9 +1384,6 @@ void S2EExecutor::registerRam(S2EExecutionState *initialState,
 #endif
         m_unusedMemoryRegions.push_back(make_pair(hostAddress, size));
     }
-
-    initialState->m_memcache.registerPool(hostAddress, size);
-
 }
 
 void S2EExecutor::registerDirtyMask(S2EExecutionState *initial_state, uint64_t host_address, uint64_t size)
@@ -1261,6 +1515,10 @@ void S2EExecutor::doLoadBalancing()
 
     unsigned parentId = m_s2e->getCurrentProcessIndex();
     m_s2e->getCorePlugin()->onProcessFork.emit(true, false, -1);
+
+    /* The solver processes belong to this process */
+    completeSeeds(0);
+
     int child = m_s2e->fork();
     if (child < 0) {
         //Fork did not succeed
@@ -1277,6 +1535,14 @@ void S2EExecutor::doLoadBalancing()
 
     m_s2e->getCorePlugin()->onProcessFork.emit(false, child, parentId);
 
+    if (child && m_checkpointFile) {
+        //The child writes its own checkpoints in its output directory,
+        //starting over with all the nodes of its states.
+        fclose(m_checkpointFile);
+        m_checkpointFile = NULL;
+        ++m_checkpointGeneration;
+    }
+
     g_s2e->getDebugStream() << "LoadBalancing: terminating states\n";
 
     for (unsigned i=lower; i<upper; ++i) {
@@ -1290,11 +1556,417 @@ void S2EExecutor::doLoadBalancing()
     vm_start();
 }
 
+/**
+ *  Folds the pc of a fork and the direction taken into the path hash of
+ *  each resulting state. States that follow the same path from the
+ *  initial state end up with the same hash, whichever process they run
+ *  in. States whose condition is constant, like the clones made by
+ *  cloneState, did not take a decision and keep the hash of the state
+ *  they come from. Every PathHashCheckpoint decisions, the hash is looked
+ *  up in the set shared by all processes, and states that reach a known
+ *  hash are scheduled for termination.
+ */
+void S2EExecutor::updatePathHashes(S2EExecutionState *state,
+                                   const std::vector<S2EExecutionState*> &newStates,
+                                   const std::vector<ref<Expr> > &conditions,
+                                   const std::vector<unsigned> &directions)
+{
+    uint64_t pathHash = state->m_pathHash;
+    uint64_t pc = state->getPc();
+    unsigned depth = state->m_pathDepth + 1;
+
+    for (unsigned i = 0; i < newStates.size(); ++i) {
+        if (isa<ConstantExpr>(conditions[i])) {
+            continue;
+        }
+
+        S2EExecutionState *newState = newStates[i];
+        newState->m_pathHash = forkPathHash(pathHash, pc, directions[i]);
+        newState->m_pathDepth = depth;
+
+        if (!m_pathHashes || depth % PathHashCheckpoint) {
+            continue;
+        }
+
+        PathHashSet *set = m_pathHashes->acquire();
+        bool isNew = set->insert(newState->m_pathHash);
+        m_pathHashes->release();
+
+        if (!isNew) {
+            m_duplicatePathStates.insert(newState);
+        }
+    }
+}
+
+/**
+ *  Terminates the states that reached an already known path hash.
+ *  This is called from the state switch timer, where killing the
+ *  current state is safe, like in doLoadBalancing.
+ */
+void S2EExecutor::terminateDuplicatePaths()
+{
+    if (m_duplicatePathStates.empty()) {
+        return;
+    }
+
+    std::vector<S2EExecutionState*> duplicates(m_duplicatePathStates.begin(),
+                                               m_duplicatePathStates.end());
+    m_duplicatePathStates.clear();
+
+    foreach2(it, duplicates.begin(), duplicates.end()) {
+        S2EExecutionState *state = *it;
+
+        //Always keep one state to run
+        if (states.size() + addedStates.size() - removedStates.size() <= 1) {
+            break;
+        }
+
+        if (state->isZombie()) {
+            continue;
+        }
+
+        m_s2e->getMessagesStream(state)
+                << "Terminating state " << state->getID()
+                << ": path " << hexval(state->m_pathHash)
+                << " was already explored\n";
+
+        ++stats::duplicatePaths;
+        stats::duplicatePathDepth += state->m_pathDepth;
+
+        m_s2e->getCorePlugin()->onStateKill.emit(state);
+        terminateStateAtFork(*state);
+        state->zombify();
+    }
+}
+
+/**
+ *  Records the fork of state into newStates for checkpoints, and follows
+ *  the checkpoint being resumed, if any. States that take a decision
+ *  leading to no checkpointed state are scheduled for termination.
+ *  Replay relies on the guest forking at the same places as in the
+ *  checkpointed run. Nondeterministic inputs are not recorded, so a fork
+ *  at another pc makes the resume fail instead of exploring the wrong paths.
+ */
+void S2EExecutor::updateCheckpointPaths(S2EExecutionState *state,
+                                        const std::vector<S2EExecutionState*> &newStates)
+{
+    uint64_t pc = state->getPc();
+    ReplayNode *replay = state->m_replayNode;
+    bool pruned = m_replayPrunedStates.count(state);
+
+    if (CheckpointInterval || CheckpointOnSignal) {
+        PathNodeRef parent = state->m_pathNode;
+        for (unsigned i = 0; i < newStates.size(); ++i) {
+            newStates[i]->m_pathNode = PathNodeRef(new PathNode(parent.get(), pc, i));
+        }
+    }
+
+    for (unsigned i = 0; i < newStates.size(); ++i) {
+        newStates[i]->m_replayNode = NULL;
+    }
+
+    if (pruned) {
+        m_replayPrunedStates.insert(newStates.begin(), newStates.end());
+        return;
+    }
+
+    if (!replay || replay->children.empty()) {
+        return;
+    }
+
+    if (replay->children.front()->pc != pc) {
+        m_s2e->getWarningsStream(state)
+                << "Checkpoint replay diverged: expected a fork at "
+                << hexval(replay->children.front()->pc) << ", got one at "
+                << hexval(pc) << ". The guest did not execute as in the "
+                << "checkpointed run, aborting the resume.\n";
+        exit(-1);
+    }
+
+    for (unsigned i = 0; i < newStates.size(); ++i) {
+        ReplayNode *child = replay->getChild(i);
+        if (!child) {
+            m_replayPrunedStates.insert(newStates[i]);
+        } else if (!child->target) {
+            newStates[i]->m_replayNode = child;
+        }
+    }
+}
+
+/**
+ *  Terminates the states whose path leaves the checkpoint being resumed.
+ *  Like terminateDuplicatePaths, this is called from the state switch timer.
+ */
+void S2EExecutor::terminateReplayPrunedStates()
+{
+    if (m_replayPrunedStates.empty()) {
+        return;
+    }
+
+    std::vector<S2EExecutionState*> pruned(m_replayPrunedStates.begin(),
+                                           m_replayPrunedStates.end());
+    m_replayPrunedStates.clear();
+
+    foreach2(it, pruned.begin(), pruned.end()) {
+        S2EExecutionState *state = *it;
+
+        //Always keep one state to run
+        if (states.size() + addedStates.size() - removedStates.size() <= 1) {
+            break;
+        }
+
+        if (state->isZombie()) {
+            continue;
+        }
+
+        m_s2e->getMessagesStream(state)
+                << "Terminating state " << state->getID()
+                << ": not part of the resumed checkpoint\n";
+
+        m_s2e->getCorePlugin()->onStateKill.emit(state);
+        terminateStateAtFork(*state);
+        state->zombify();
+    }
+}
+
+void S2EExecutor::terminateStateAtSwitch(S2EExecutionState *state,
+                                         const std::string &message)
+{
+    assert(state != g_s2e_state);
+    m_pendingTerminations[state] = message;
+}
+
+/**
+ *  Terminates the states passed to terminateStateAtSwitch. States are only
+ *  scheduled by the state switch timer, which calls this first.
+ */
+void S2EExecutor::terminatePendingStates()
+{
+    if (m_pendingTerminations.empty()) {
+        return;
+    }
+
+    std::map<S2EExecutionState*, std::string> pending;
+    pending.swap(m_pendingTerminations);
+
+    foreach2(it, pending.begin(), pending.end()) {
+        S2EExecutionState *state = it->first;
+
+        //Always keep one state to run
+        if (states.size() + addedStates.size() - removedStates.size() <= 1) {
+            break;
+        }
+
+        if (state->isZombie()) {
+            continue;
+        }
+
+        m_s2e->getMessagesStream(state)
+                << "Terminating state " << state->getID()
+                << ": " << it->second << '\n';
+
+        m_s2e->getCorePlugin()->onStateKill.emit(state);
+        terminateStateAtFork(*state);
+        state->zombify();
+    }
+}
+
+void S2EExecutor::checkpointIfNeeded()
+{
+    bool requested = s_checkpointRequested;
+    int64_t now = qemu_get_clock_ms(host_clock);
+
+    if (CheckpointInterval && !m_lastCheckpointTime) {
+        m_lastCheckpointTime = now;
+    }
+
+    if (CheckpointInterval &&
+            now - m_lastCheckpointTime >= (int64_t) CheckpointInterval * 1000) {
+        requested = true;
+    }
+
+    if (!requested) {
+        return;
+    }
+
+    s_checkpointRequested = 0;
+    m_lastCheckpointTime = now;
+    writeCheckpoint();
+}
+
+/**
+ *  Appends to the file the nodes of a checkpoint that are not there yet,
+ *  parents first. Returns the identifier of node.
+ */
+uint64_t S2EExecutor::writeCheckpointNode(PathNode *node)
+{
+    std::vector<PathNode*> unwritten;
+    for (PathNode *n = node; n && n->generation != m_checkpointGeneration; n = n->parent) {
+        unwritten.push_back(n);
+    }
+
+    for (unsigned i = unwritten.size(); i > 0; --i) {
+        PathNode *n = unwritten[i - 1];
+        n->id = m_nextCheckpointNodeId++;
+        n->generation = m_checkpointGeneration;
+        fprintf(m_checkpointFile, "n %llu %llu 0x%llx %u\n",
+                (unsigned long long) n->id,
+                (unsigned long long) (n->parent ? n->parent->id : 0),
+                (unsigned long long) n->pc, n->index);
+    }
+
+    return node ? node->id : 0;
+}
+
+/**
+ *  Appends the fork decisions of all live states to checkpoint.paths.
+ *  The file is a log of lines:
+ *    n <id> <parent id> <pc> <index>   fork decision (parent 0 is the root)
+ *    c <sequence> <count>              start of a checkpoint of count states
+ *    s <id>                            last decision of a state
+ *    e                                 end of the checkpoint
+ *  Nodes are written once per file, so the log only grows by the decisions
+ *  taken since the previous checkpoint. A checkpoint without its final
+ *  line was interrupted and is ignored when resuming.
+ */
+void S2EExecutor::writeCheckpoint()
+{
+    if (!m_checkpointFile) {
+        std::string fileName = m_s2e->getOutputFilename("checkpoint.paths");
+        m_checkpointFile = fopen(fileName.c_str(), "w");
+        if (!m_checkpointFile) {
+            m_s2e->getWarningsStream()
+                    << "Could not open " << fileName << " for writing\n";
+            return;
+        }
+    }
+
+    std::vector<uint64_t> ids;
+
+    foreach2(it, states.begin(), states.end()) {
+        S2EExecutionState *state = static_cast<S2EExecutionState*>(*it);
+        if (state->isZombie() || removedStates.count(state)) {
+            continue;
+        }
+        ids.push_back(writeCheckpointNode(state->m_pathNode.get()));
+    }
+
+    foreach2(it, addedStates.begin(), addedStates.end()) {
+        S2EExecutionState *state = static_cast<S2EExecutionState*>(*it);
+        if (!state->isZombie()) {
+            ids.push_back(writeCheckpointNode(state->m_pathNode.get()));
+        }
+    }
+
+    fprintf(m_checkpointFile, "c %u %u\n", m_checkpointCount++, (unsigned) ids.size());
+    foreach2(it, ids.begin(), ids.end()) {
+        fprintf(m_checkpointFile, "s %llu\n", (unsigned long long) *it);
+    }
+    fprintf(m_checkpointFile, "e\n");
+
+    fflush(m_checkpointFile);
+#ifndef _WIN32
+    fsync(fileno(m_checkpointFile));
+#endif
+
+    m_s2e->getDebugStream() << "Checkpoint " << (m_checkpointCount - 1)
+                            << ": " << ids.size() << " states\n";
+}
+
+/**
+ *  Reads the last complete checkpoint of fileName and builds the tree of
+ *  fork decisions leading to its states.
+ */
+bool S2EExecutor::loadCheckpoint(const std::string &fileName)
+{
+    FILE *fp = fopen(fileName.c_str(), "r");
+    if (!fp) {
+        return false;
+    }
+
+    std::map<uint64_t, CheckpointNode> nodes;
+    std::vector<uint64_t> targets, pending;
+    bool complete = false;
+    char line[128];
+
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long long id, parent, pc;
+        unsigned index;
+
+        switch (line[0]) {
+        case 'n':
+            if (sscanf(line, "n %llu %llu %llx %u", &id, &parent, &pc, &index) == 4) {
+                CheckpointNode info = { parent, pc, index };
+                nodes[id] = info;
+            }
+            break;
+        case 'c':
+            pending.clear();
+            break;
+        case 's':
+            if (sscanf(line, "s %llu", &id) == 1) {
+                pending.push_back(id);
+            }
+            break;
+        case 'e':
+            targets = pending;
+            complete = true;
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    if (!complete) {
+        return false;
+    }
+
+    m_replayRoot = new ReplayNode(0, 0);
+    m_replayNodes.push_back(m_replayRoot);
+
+    foreach2(it, targets.begin(), targets.end()) {
+        std::vector<const CheckpointNode*> path;
+        uint64_t id = *it;
+
+        while (id) {
+            std::map<uint64_t, CheckpointNode>::const_iterator nit = nodes.find(id);
+            if (nit == nodes.end()) {
+                m_s2e->getWarningsStream() << "Checkpoint " << fileName
+                                           << " refers to unknown node " << id << '\n';
+                return false;
+            }
+            path.push_back(&nit->second);
+            id = nit->second.parent;
+        }
+
+        ReplayNode *node = m_replayRoot;
+        for (unsigned i = path.size(); i > 0; --i) {
+            ReplayNode *child = node->getChild(path[i - 1]->index);
+            if (!child) {
+                child = new ReplayNode(path[i - 1]->pc, path[i - 1]->index);
+                node->children.push_back(child);
+                m_replayNodes.push_back(child);
+            }
+            node = child;
+        }
+        node->target = true;
+    }
+
+    m_s2e->getMessagesStream() << "Resuming " << targets.size()
+                               << " states from checkpoint " << fileName << '\n';
+    return true;
+}
+
 void S2EExecutor::stateSwitchTimerCallback(void *opaque)
 {
     S2EExecutor *c = (S2EExecutor*)opaque;
 
     if (g_s2e_state) {
+        c->terminateDuplicatePaths();
+        c->terminateReplayPrunedStates();
+        c->terminatePendingStates();
+        c->checkpointIfNeeded();
+        c->completeSeeds(GenerationalSolverJobs);
         c->doLoadBalancing();
         S2EExecutionState *nextState = c->selectNextState(g_s2e_state);
         if (nextState) {
@@ -1314,6 +1986,28 @@ void S2EExecutor::initializeStateSwitchTimer()
     qemu_mod_timer(m_stateSwitchTimer, qemu_get_clock_ms(host_clock) + 100);
 }
 
+/**
+ * Copy the host memory of a concrete object into the state.
+ * Objects whose contents did not change since they were last saved are
+ * left shared with the other states instead of being copied on write,
+ * which also lets doStateSwitch skip restoring them.
+ */
+void S2EExecutor::saveConcreteObject(S2EExecutionState *state,
+                                     const MemoryObject *mo)
+{
+    const ObjectState *os = state->addressSpace.findObject(mo);
+    const uint8_t *store = os->getConcreteStore();
+    assert(store);
+
+    if (SkipUnchangedOnStateSwitch &&
+        !memcmp(store, (uint8_t*) mo->address, mo->size)) {
+        return;
+    }
+
+    ObjectState *wos = state->addressSpace.getWriteable(mo, os);
+    memcpy(wos->getConcreteStore(), (uint8_t*) mo->address, mo->size);
+}
+
 void S2EExecutor::doStateSwitch(S2EExecutionState* oldState,
                                 S2EExecutionState* newState)
 {
@@ -1357,11 +2051,7 @@ void S2EExecutor::doStateSwitch(S2EExecutionState* oldState,
             if(mo == cpuMo)
                 continue;
 
-            const ObjectState *oldOS = oldState->addressSpace.findObject(mo);
-            ObjectState *oldWOS = oldState->addressSpace.getWriteable(mo, oldOS);
-            uint8_t *oldStore = oldWOS->getConcreteStore();
-            assert(oldStore);
-            memcpy(oldStore, (uint8_t*) mo->address, mo->size);
+            saveConcreteObject(oldState, mo);
         }
 
         //copyInConcretes(*oldState);
@@ -1377,6 +2067,7 @@ void S2EExecutor::doStateSwitch(S2EExecutionState* oldState,
 
     uint64_t totalCopied = 0;
     uint64_t objectsCopied = 0;
+    uint64_t totalSkipped = 0;
 
     if(newState) {
         timers_state = *newState->m_timersState;
@@ -1395,6 +2086,19 @@ void S2EExecutor::doStateSwitch(S2EExecutionState* oldState,
                 continue;
 
             const ObjectState *newOS = newState->addressSpace.findObject(mo);
+
+            /**
+             * The old state has just saved the host memory into its
+             * object. If both states still share that object, which is
+             * the case for most of the RAM of states that forked from
+             * each other, the memory already holds the new contents.
+             */
+            if (SkipUnchangedOnStateSwitch && oldState &&
+                oldState->addressSpace.findObject(mo) == newOS) {
+                totalSkipped += mo->size;
+                continue;
+            }
+
             const uint8_t *newStore = newOS->getConcreteStore();
             assert(newStore);
             memcpy((uint8_t*) mo->address, newStore, mo->size);
@@ -1430,7 +2134,8 @@ void S2EExecutor::doStateSwitch(S2EExecutionState* oldState,
     cpu_enable_ticks();
 
     if (VerboseStateSwitching) {
-        s2e_debug_print("Copied %d (count=%d)\n", totalCopied, objectsCopied);
+        s2e_debug_print("Copied %"PRIu64" (count=%"PRIu64"), skipped %"PRIu64"\n",
+                        totalCopied, objectsCopied, totalSkipped);
     }
 
     if(FlushTBsOnStateSwitch)
@@ -1458,7 +2163,12 @@ ExecutionState* S2EExecutor::selectNonSpeculativeState(S2EExecutionState *state)
             //The searcher wants us to execute a speculative state.
             //The engine must make sure that such a state
             //satisfies all the path constraints.
-            if (!resolveSpeculativeState(*newState)) {
+            S2EExecutionState *s2eState = static_cast<S2EExecutionState*>(newState);
+            s2eState->m_branching = true;
+            bool resolved = resolveSpeculativeState(*newState);
+            s2eState->m_branching = false;
+
+            if (!resolved) {
                 terminateState(*newState);
                 updateStates(state);
                 continue;
@@ -1544,6 +2254,43 @@ S2EExecutionState* S2EExecutor::selectNextState(S2EExecutionState *state)
     return newState;
 }
 
+/** Assign an address to the functions that c refers to and that
+    do not have one yet */
+void S2EExecutor::bindFunctionAddresses(llvm::Constant *c)
+{
+    if (Function *f = dyn_cast<Function>(c)) {
+        if (globalAddresses.count(f)) {
+            return;
+        }
+
+        ref<klee::ConstantExpr> addr(0);
+
+        // If the symbol has external weak linkage then it is implicitly
+        // not defined in this module; if it isn't resolvable then it
+        // should be null.
+        if (f->hasExternalWeakLinkage() &&
+                !externalDispatcher->resolveSymbol(f->getName())) {
+            addr = Expr::createPointer(0);
+        } else {
+            addr = Expr::createPointer((uintptr_t) (void*) f);
+            legalFunctions.insert((uint64_t) (uintptr_t) (void*) f);
+        }
+
+        globalAddresses.insert(std::make_pair(f, addr));
+        return;
+    }
+
+    if (isa<GlobalValue>(c)) {
+        return;
+    }
+
+    for (unsigned i = 0; i < c->getNumOperands(); ++i) {
+        if (Constant *op = dyn_cast<Constant>(c->getOperand(i))) {
+            bindFunctionAddresses(op);
+        }
+    }
+}
+
 /** Simulate start of function execution, creating KLEE structs of required */
 void S2EExecutor::prepareFunctionExecution(S2EExecutionState *state,
                             llvm::Function *function,
@@ -1563,32 +2310,13 @@ void S2EExecutor::prepareFunctionExecution(S2EExecutionState *state,
             bindInstructionConstants(kf->instructions[i]);
 
         /* Update global functions (new functions can be added
-           while creating added function) */
-        for (Module::iterator i = kmodule->module->begin(),
-                              ie = kmodule->module->end(); i != ie; ++i) {
-            Function *f = i;
-            ref<klee::ConstantExpr> addr(0);
-
-            // If the symbol has external weak linkage then it is implicitly
-            // not defined in this module; if it isn't resolvable then it
-            // should be null.
-            if (f->hasExternalWeakLinkage() &&
-                    !externalDispatcher->resolveSymbol(f->getName())) {
-                addr = Expr::createPointer(0);
-            } else {
-                addr = Expr::createPointer((uintptr_t) (void*) f);
-                legalFunctions.insert((uint64_t) (uintptr_t) (void*) f);
-            }
-
-            globalAddresses.insert(std::make_pair(f, addr));
-        }
-
-        kmodule->constantTable.resize(kmodule->constants.size());
-
+           while creating added function). Only the new constants
+           can refer to them. */
         for(unsigned i = cIndex; i < kmodule->constants.size(); ++i) {
-            Cell &c = kmodule->constantTable[i];
-            c.value = evalConstant(kmodule->constants[i]);
+            bindFunctionAddresses(kmodule->constants[i]);
         }
+
+        bindConstants(cIndex);
     }
 
     /* Emulate call to a TB function */
@@ -2035,6 +2763,9 @@ void S2EExecutor::deleteState(klee::ExecutionState *state)
     assert(dynamic_cast<S2EExecutionState*>(state));
     processTree->remove(state->ptreeNode);
     m_deletedStates.push_back(static_cast<S2EExecutionState*>(state));
+    m_duplicatePathStates.erase(static_cast<S2EExecutionState*>(state));
+    m_replayPrunedStates.erase(static_cast<S2EExecutionState*>(state));
+    m_pendingTerminations.erase(static_cast<S2EExecutionState*>(state));
 }
 
 void S2EExecutor::notifyFork(ExecutionState &originalState, ref<Expr> &condition,
@@ -2097,6 +2828,303 @@ void S2EExecutor::doStateFork(S2EExecutionState *originalState,
     }   
 }
 
+ForkSite &S2EExecutor::getForkSite(uint64_t pc)
+{
+    std::map<uint64_t, ForkSite>::iterator it = m_forkSites.find(pc);
+    if (it != m_forkSites.end()) {
+        return it->second;
+    }
+
+    ForkSite &site = m_forkSites[pc];
+    site.budget = ForkSiteBudget;
+    site.policy = ForkSitePolicy;
+    return site;
+}
+
+/**
+ *  Constrains the symbolic reads of condition to their current values,
+ *  so that the condition and later ones depending on the same data do
+ *  not fork anymore. Returns the condition to fork on.
+ */
+ref<Expr> S2EExecutor::concretizeCondition(S2EExecutionState &state,
+                                          ref<Expr> condition)
+{
+    std::vector<ref<ReadExpr> > reads;
+    findReads(condition, false, reads);
+
+    foreach2(it, reads.begin(), reads.end()) {
+        ref<Expr> value;
+        if (ConcolicMode) {
+            value = state.concolics.evaluate(*it);
+        } else {
+            ref<ConstantExpr> ce;
+            if (!getSolver()->getValue(Query(state.constraints, *it), ce)) {
+                return condition;
+            }
+            value = ce;
+        }
+        addConstraint(state, EqExpr::create(*it, value));
+    }
+
+    return ConcolicMode ? state.concolics.evaluate(condition) : condition;
+}
+
+void S2EExecutor::writeForkSiteStats()
+{
+    if (!ForkSiteStats) {
+        return;
+    }
+
+    llvm::raw_ostream *os = interpreterHandler->openOutputFile("forksites.stats");
+    if (!os) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t> > sites;
+    foreach2(it, m_forkSites.begin(), m_forkSites.end()) {
+        sites.push_back(std::make_pair(it->second.forks, it->first));
+    }
+    std::sort(sites.rbegin(), sites.rend());
+
+    *os << "# pc conditions forks infeasible over-budget solver-time budget policy\n";
+    foreach2(it, sites.begin(), sites.end()) {
+        const ForkSite &site = m_forkSites[it->second];
+        *os << hexval(it->second)
+            << " " << site.conditions
+            << " " << site.forks
+            << " " << site.infeasible
+            << " " << site.budgeted
+            << " " << site.solverTime / 1000000.
+            << " " << site.budget
+            << " " << (site.policy == ForkSite::STOP ? "stop" : "concretize")
+            << '\n';
+    }
+
+    delete os;
+}
+
+/**
+ *  Turns the branches logged along a terminated generational path into
+ *  new seeds. A branch is negated unless an earlier path already negated
+ *  it after the same sequence of decisions. Each query only keeps the
+ *  path constraints that share arrays, directly or not, with the negated
+ *  branch. With GenerationalSolverJobs, the queries are sent to the
+ *  solver processes and the seeds are written once they are solved.
+ */
+void S2EExecutor::generateSeeds(S2EExecutionState &state)
+{
+    std::vector<LoggedBranch> &log = state.m_branchLog;
+    if (log.empty()) {
+        return;
+    }
+
+    std::vector<unsigned> branches;
+    uint64_t hash = hash64(0);
+    for (unsigned i = 0; i < log.size(); ++i) {
+        hash = hash64(log[i].pc, hash);
+        if (m_negatedBranches.insert(hash64(!log[i].taken, hash)).second) {
+            branches.push_back(i);
+        }
+        hash = hash64(log[i].taken, hash);
+    }
+
+    stats::negatedBranches += branches.size();
+
+    const std::vector<ref<Expr> > &constraints = state.m_constraintLog;
+
+    std::vector<std::vector<const Array*> > constraintArrays(constraints.size());
+    for (unsigned i = 0; i < constraints.size() && !branches.empty(); ++i) {
+        findSymbolicObjects(constraints[i], constraintArrays[i]);
+    }
+
+    SolutionFuture::ConcreteInputs concolics;
+    foreach2(it, state.symbolics.begin(), state.symbolics.end()) {
+        const Array *array = it->second;
+        std::vector<unsigned char> data(array->size, 0);
+
+        Assignment::bindings_ty::const_iterator bit =
+                state.concolics.bindings.find(array);
+        if (bit != state.concolics.bindings.end()) {
+            std::copy(bit->second.begin(),
+                      bit->second.begin() + std::min<size_t>(bit->second.size(), data.size()),
+                      data.begin());
+        }
+
+        concolics.push_back(std::make_pair(array->name, data));
+    }
+
+    foreach2(bit, branches.begin(), branches.end()) {
+        const LoggedBranch &branch = log[*bit];
+        ref<Expr> taken = branch.taken ? branch.condition
+                                       : Expr::createIsZero(branch.condition);
+        unsigned prefix = std::min<unsigned>(branch.constraints, constraints.size());
+
+        std::vector<const Array*> objects;
+        findSymbolicObjects(taken, objects);
+        std::set<const Array*> arrays(objects.begin(), objects.end());
+
+        std::vector<bool> inSlice(prefix, false);
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (unsigned i = 0; i < prefix; ++i) {
+                if (inSlice[i]) {
+                    continue;
+                }
+                const std::vector<const Array*> &cas = constraintArrays[i];
+                foreach2(it, cas.begin(), cas.end()) {
+                    if (arrays.count(*it)) {
+                        arrays.insert(cas.begin(), cas.end());
+                        inSlice[i] = changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::vector<ref<Expr> > slice;
+        for (unsigned i = 0; i < prefix; ++i) {
+            if (inSlice[i]) {
+                slice.push_back(constraints[i]);
+            }
+        }
+
+        SolverObjects namedObjects;
+        foreach2(it, arrays.begin(), arrays.end()) {
+            namedObjects.push_back(std::make_pair((*it)->name, *it));
+        }
+
+        if (GenerationalSolverJobs) {
+            completeSeeds(GenerationalSolverJobs - 1);
+
+            /* A model of the slice where the branch goes the other way */
+            std::vector<ref<Expr> > query(slice);
+            query.push_back(Expr::createIsZero(taken));
+
+            PendingSeed seed;
+            seed.future = solveAsync(query, std::vector<ref<Expr> >(), namedObjects);
+            if (seed.future) {
+                seed.stateId = state.getID();
+                seed.branch = *bit;
+                seed.concolics = concolics;
+                m_pendingSeeds.push_back(seed);
+                continue;
+            }
+        }
+
+        ConstraintManager sliceConstraints(slice);
+        std::vector<std::vector<unsigned char> > values;
+        objects.assign(arrays.begin(), arrays.end());
+        if (!getSolver()->getInitialValues(Query(sliceConstraints, taken),
+                                           objects, values)) {
+            continue;
+        }
+
+        SolutionFuture::ConcreteInputs solution;
+        for (unsigned i = 0; i < objects.size(); ++i) {
+            solution.push_back(std::make_pair(objects[i]->name, values[i]));
+        }
+        writeSeed(state.getID(), *bit, concolics, solution);
+    }
+
+    log.clear();
+}
+
+/**
+ *  Writes one seed file per symbolic array of the state, with the solved
+ *  values of the arrays in solution and the concolic values of the other
+ *  ones. The file of each array goes to seeds/<array>/seed-<state>-<branch>,
+ *  so that each directory can feed a single concolic buffer.
+ */
+void S2EExecutor::writeSeed(int stateId, unsigned branch,
+                            const SolutionFuture::ConcreteInputs &concolics,
+                            const SolutionFuture::ConcreteInputs &solution)
+{
+    foreach2(it, concolics.begin(), concolics.end()) {
+        const std::vector<unsigned char> *data = &it->second;
+        foreach2(sit, solution.begin(), solution.end()) {
+            if (sit->first == it->first) {
+                data = &sit->second;
+                break;
+            }
+        }
+
+        std::string arrayName = it->first;
+        std::replace(arrayName.begin(), arrayName.end(), '/', '_');
+
+        /* Each process started by load balancing has its own output directory */
+        llvm::sys::Path seedDir(m_s2e->getOutputFilename("seeds/" + arrayName));
+        std::string error;
+        if (seedDir.createDirectoryOnDisk(true, &error)) {
+            m_s2e->getWarningsStream() << "Could not create " << seedDir.str()
+                                       << ": " << error << '\n';
+            return;
+        }
+
+        std::stringstream name;
+        name << "seeds/" << arrayName << "/seed-" << stateId << "-" << branch;
+        llvm::raw_ostream *os = m_s2e->openOutputFile(name.str());
+
+        for (unsigned i = 0; i < it->second.size(); ++i) {
+            os->write(i < data->size() ? (*data)[i] : 0);
+        }
+
+        delete os;
+    }
+}
+
+/**
+ *  Writes the seeds solved in the background, in the order in which they
+ *  were requested, and waits until at most maxPending are left.
+ */
+void S2EExecutor::completeSeeds(unsigned maxPending)
+{
+    while (!m_pendingSeeds.empty()) {
+        PendingSeed &seed = m_pendingSeeds.front();
+        if (m_pendingSeeds.size() <= maxPending && !seed.future->isReady()) {
+            break;
+        }
+
+        SolutionFuture::ConcreteInputs solution;
+        if (seed.future->get(solution)) {
+            writeSeed(seed.stateId, seed.branch, seed.concolics, solution);
+        }
+
+        delete seed.future;
+        m_pendingSeeds.pop_front();
+    }
+}
+
+void S2EExecutor::notifyExprConcretized(ExecutionState &state,
+                                        const ref<Expr> &e)
+{
+    ++m_concretizedExprSites[static_cast<S2EExecutionState*>(&state)->getPc()];
+}
+
+void S2EExecutor::writeConcretizedExprStats()
+{
+    if (m_concretizedExprSites.empty()) {
+        return;
+    }
+
+    llvm::raw_ostream *os = interpreterHandler->openOutputFile("concretizedexprs.stats");
+    if (!os) {
+        return;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t> > sites;
+    foreach2(it, m_concretizedExprSites.begin(), m_concretizedExprSites.end()) {
+        sites.push_back(std::make_pair(it->second, it->first));
+    }
+    std::sort(sites.rbegin(), sites.rend());
+
+    *os << "# pc concretized\n";
+    foreach2(it, sites.begin(), sites.end()) {
+        *os << hexval(it->second) << " " << it->first << '\n';
+    }
+
+    delete os;
+}
+
 S2EExecutor::StatePair S2EExecutor::fork(ExecutionState &current,
                             ref<Expr> condition, bool isInternal)
 {
@@ -2105,12 +3133,75 @@ S2EExecutor::StatePair S2EExecutor::fork(ExecutionState &current,
 
     StatePair res;
 
+    condition = limitExprComplexity(current, condition);
+
+    ForkSite *site = NULL;
+    bool overBudget = false;
+    bool forkDisabled = current.forkDisabled;
+    uint64_t solverTime = 0;
+
+    if (m_forkSiteAccounting && !isa<ConstantExpr>(condition)) {
+        site = &getForkSite(static_cast<S2EExecutionState*>(&current)->getPc());
+        ++site->conditions;
+
+        if (site->budget && site->forks >= site->budget && !forkDisabled) {
+            overBudget = true;
+            ++site->budgeted;
+            ++stats::budgetedForks;
+
+            if (site->policy == ForkSite::CONCRETIZE) {
+                condition = concretizeCondition(
+                        *static_cast<S2EExecutionState*>(&current), condition);
+            } else {
+                current.forkDisabled = true;
+            }
+        }
+
+        solverTime = stats::solverTime;
+    }
+
+    /* In generational mode the path follows its seed and the branch is
+       only logged, its negation is solved later (see generateSeeds) */
+    bool logBranch = ConcolicGenerational && !isa<ConstantExpr>(condition) &&
+                     !current.forkDisabled;
+    unsigned constraints = static_cast<S2EExecutionState*>(&current)->m_constraintLog.size();
+
+    static_cast<S2EExecutionState*>(&current)->m_branching = true;
+
     if (ConcolicMode) {
+        if (logBranch) {
+            current.forkDisabled = true;
+        }
         res = Executor::concolicFork(current, condition, isInternal);
+        if (logBranch) {
+            S2EExecutionState *state = static_cast<S2EExecutionState*>(&current);
+            current.forkDisabled = forkDisabled;
+            state->m_branchLog.push_back(LoggedBranch(state->getPc(), constraints,
+                                                      condition, res.first != NULL));
+            ++stats::loggedBranches;
+        }
     } else {
         res = Executor::fork(current, condition, isInternal);
     }
 
+    /* The state branched by the fork inherits the flag */
+    static_cast<S2EExecutionState*>(&current)->m_branching = false;
+    if (res.first)
+        static_cast<S2EExecutionState*>(res.first)->m_branching = false;
+    if (res.second)
+        static_cast<S2EExecutionState*>(res.second)->m_branching = false;
+
+    if (site) {
+        current.forkDisabled = forkDisabled;
+        site->solverTime += stats::solverTime - solverTime;
+
+        if (res.first && res.second) {
+            ++site->forks;
+        } else if ((res.first || res.second) && !overBudget && !logBranch) {
+            ++site->infeasible;
+        }
+    }
+
     if(res.first && res.second) {
 
         assert(dynamic_cast<S2EExecutionState*>(res.first));
@@ -2125,6 +3216,14 @@ S2EExecutor::StatePair S2EExecutor::fork(ExecutionState &current,
         newConditions[0] = condition;
         newConditions[1] = klee::NotExpr::create(condition);
 
+        std::vector<unsigned> directions(2);
+        directions[0] = 0;
+        directions[1] = 1;
+
+        updatePathHashes(static_cast<S2EExecutionState*>(&current), newStates,
+                         newConditions, directions);
+        updateCheckpointPaths(static_cast<S2EExecutionState*>(&current), newStates);
+
         doStateFork(static_cast<S2EExecutionState*>(&current),
                        newStates, newConditions);
     }
@@ -2149,11 +3248,7 @@ void S2EExecutor::notifyBranch(ExecutionState &state)
      * getWritable() may modify the TLB.
      */
     foreach(MemoryObject* mo, m_saveOnContextSwitch) {
-        const ObjectState *os = s2eState->addressSpace.findObject(mo);
-        ObjectState *wos = s2eState->addressSpace.getWriteable(mo, os);
-        uint8_t *store = wos->getConcreteStore();
-        assert(store);
-        memcpy(store, (uint8_t*) mo->address, mo->size);
+        saveConcreteObject(s2eState, mo);
     }
 
     /* Save CPU state */
@@ -2175,25 +3270,34 @@ void S2EExecutor::branch(klee::ExecutionState &state,
     S2EExecutionState *s2eState = dynamic_cast<S2EExecutionState*>(&state);
     assert(!s2eState->m_runningConcrete);
 
+    s2eState->m_branching = true;
     Executor::branch(state, conditions, result);
+    s2eState->m_branching = false;
 
     unsigned n = conditions.size();
 
     vector<S2EExecutionState*> newStates;
     vector<ref<Expr> > newConditions;
+    vector<unsigned> directions;
 
     newStates.reserve(n);
     newConditions.reserve(n);
+    directions.reserve(n);
 
     for(unsigned i = 0; i < n; ++i) {
         if(result[i]) {
             assert(dynamic_cast<S2EExecutionState*>(result[i]));
+            static_cast<S2EExecutionState*>(result[i])->m_branching = false;
             newStates.push_back(static_cast<S2EExecutionState*>(result[i]));
             newConditions.push_back(conditions[i]);
+            directions.push_back(i);
         }
     }
 
     if(newStates.size() > 1) {
+        updatePathHashes(s2eState, newStates, newConditions, directions);
+        updateCheckpointPaths(s2eState, newStates);
+
         doStateFork(static_cast<S2EExecutionState*>(&state),
                        newStates, newConditions);
     }
@@ -2215,6 +3319,7 @@ bool S2EExecutor::merge(klee::ExecutionState &_base, klee::ExecutionState &_othe
     if(base.merge(other)) {
         m_s2e->getMessagesStream(&base)
                 << "Merged with state " << other.getID() << '\n';
+        m_s2e->getCorePlugin()->onStateMerge.emit(&base, &other);
         return true;
     } else {
         m_s2e->getDebugStream(&base)
@@ -2236,6 +3341,10 @@ void S2EExecutor::terminateState(ExecutionState &s)
     S2EExecutionState& state = static_cast<S2EExecutionState&>(s);
     m_s2e->getCorePlugin()->onStateKill.emit(&state);
 
+    if (ConcolicGenerational) {
+        generateSeeds(state);
+    }
+
     terminateStateAtFork(state);
     state.zombify();
 
@@ -2437,17 +3546,197 @@ bool S2EExecutor::resumeState(S2EExecutionState *state, bool onlyAddToPtree)
 }
 
 
+void S2EExecutor::cloneState(S2EExecutionState *state, unsigned count,
+                             std::vector<S2EExecutionState*> &clones)
+{
+    vector<ref<Expr> > conditions(count + 1,
+                                  ConstantExpr::create(1, Expr::Bool));
+    vector<ExecutionState*> result;
+
+    branch(*state, conditions, result);
+
+    foreach2(it, result.begin(), result.end()) {
+        if (*it != state) {
+            clones.push_back(static_cast<S2EExecutionState*>(*it));
+        }
+    }
+}
+
+/* Records of the requests sent to the solver processes */
+enum SolverRequestRecord {
+    SolverConstraintRecord = ExprStream::FirstUserRecord, /* expr */
+    SolverPreferenceRecord, /* expr */
+    SolverObjectRecord /* name, array */
+};
+
+SolutionFuture *S2EExecutor::getSymbolicSolutionAsync(S2EExecutionState &state)
+{
+    /* Same query as Executor::getSymbolicSolution */
+    std::vector<ref<Expr> > constraints(state.constraints.begin(),
+                                        state.constraints.end());
+    std::vector<ref<Expr> > preferences;
+    SolverObjects objects;
+
+    foreach2(it, state.symbolics.begin(), state.symbolics.end()) {
+        const MemoryObject *mo = it->first;
+        if (!NoPreferCex) {
+            preferences.insert(preferences.end(), mo->cexPreferences.begin(),
+                               mo->cexPreferences.end());
+        }
+        objects.push_back(std::make_pair(mo->name, it->second));
+    }
+
+    return solveAsync(constraints, preferences, objects);
+}
+
+/**
+ *  Sends the query to the solver pool. Preferences are added to the
+ *  constraints when they are satisfiable, and the reply holds the values
+ *  of the objects, under the given names.
+ */
+SolutionFuture *S2EExecutor::solveAsync(const std::vector<ref<Expr> > &constraints,
+                                        const std::vector<ref<Expr> > &preferences,
+                                        const SolverObjects &objects)
+{
+#ifdef _WIN32
+    return NULL;
+#else
+    if (m_solverPool && !m_solverPool->isOwner()) {
+        /* The workers belong to the process this one was forked from */
+        delete m_solverPool;
+        m_solverPool = NULL;
+    }
+
+    if (!m_solverPool) {
+        m_solverPool = new SolverPool(SolverWorkers, &S2EExecutor::solveRequest);
+    }
+
+    ExprStreamWriter writer;
+    foreach2(it, constraints.begin(), constraints.end()) {
+        unsigned id = writer.write(*it);
+        writer.writeVarint(SolverConstraintRecord);
+        writer.writeVarint(id);
+    }
+
+    foreach2(it, preferences.begin(), preferences.end()) {
+        unsigned id = writer.write(*it);
+        writer.writeVarint(SolverPreferenceRecord);
+        writer.writeVarint(id);
+    }
+
+    foreach2(it, objects.begin(), objects.end()) {
+        unsigned id = writer.write(it->second);
+        writer.writeVarint(SolverObjectRecord);
+        writer.writeString(it->first);
+        writer.writeVarint(id);
+    }
+
+    return m_solverPool->submit(writer.getBuffer());
+#endif
+}
+
+/** Runs in a solver process. An empty reply reports a failure. */
+void S2EExecutor::solveRequest(const std::vector<unsigned char> &request,
+                               std::vector<char> &reply)
+{
+    S2EExecutor *executor = g_s2e->getExecutor();
+    if (request.empty()) {
+        /* Nothing symbolic */
+        SolutionFuture::serialize(SolutionFuture::ConcreteInputs(), reply);
+        return;
+    }
+
+    std::vector<ref<Expr> > constraints, preferences;
+    std::vector<const Array*> objects;
+    std::vector<std::string> names;
+
+    ExprStreamReader reader(&request[0], &request[0] + request.size());
+    while (unsigned tag = reader.nextRecord()) {
+        switch (tag) {
+            case SolverConstraintRecord:
+                constraints.push_back(reader.getExpr(reader.readVarint()));
+                if (constraints.back().isNull()) {
+                    return;
+                }
+                break;
+
+            case SolverPreferenceRecord:
+                preferences.push_back(reader.getExpr(reader.readVarint()));
+                if (preferences.back().isNull()) {
+                    return;
+                }
+                break;
+
+            case SolverObjectRecord:
+                names.push_back(reader.readString());
+                objects.push_back(reader.getArray(reader.readVarint()));
+                if (!objects.back()) {
+                    return;
+                }
+                break;
+
+            default:
+                return;
+        }
+    }
+
+    if (reader.hasError()) {
+        return;
+    }
+
+    Solver *solver = executor->getSolver();
+    solver->setTimeout(executor->stpTimeout);
+
+    ConstraintManager manager(constraints);
+    foreach2(it, preferences.begin(), preferences.end()) {
+        bool mustBeTrue;
+        if (!solver->mustBeTrue(Query(manager, Expr::createIsZero(*it)), mustBeTrue)) {
+            break;
+        }
+        if (!mustBeTrue) {
+            manager.addConstraint(*it);
+        }
+    }
+
+    std::vector<std::vector<unsigned char> > values;
+    if (!solver->getInitialValues(Query(manager, ConstantExpr::alloc(0, Expr::Bool)),
+                                  objects, values)) {
+        return;
+    }
+
+    SolutionFuture::ConcreteInputs out;
+    for (unsigned i = 0; i < objects.size(); ++i) {
+        out.push_back(std::make_pair(names[i], values[i]));
+    }
+    SolutionFuture::serialize(out, reply);
+}
+
+/**
+ * Drops one reference to the translation block. The TB itself holds one
+ * reference while it is in QEMU's TB cache, each state holds one for
+ * the TB it last executed in KLEE. Once nobody references the TB anymore,
+ * its LLVM function, KFunction, JIT code and all the bookkeeping
+ * the executor keeps about it are released.
+ */
 void S2EExecutor::unrefS2ETb(S2ETranslationBlock* s2e_tb)
 {
     if(s2e_tb && 0 == --s2e_tb->refCount) {
         if(s2e_tb->llvm_function && !KeepLLVMFunctions) {
+            llvm::Function *f = s2e_tb->llvm_function;
+
+            globalAddresses.erase(f);
+            legalFunctions.erase((uint64_t) (uintptr_t) (void*) f);
+
             S2EExternalDispatcher *s2eDispatcher = static_cast<S2EExternalDispatcher*>(externalDispatcher);
-            s2eDispatcher->removeFunction(s2e_tb->llvm_function);
-            kmodule->removeFunction(s2e_tb->llvm_function);
+            s2eDispatcher->removeFunction(f);
+            kmodule->removeFunction(f);
+
+            ++stats::translationBlockFunctionsErased;
         }
         foreach(void* s, s2e_tb->executionSignals) {
             delete static_cast<ExecutionSignal*>(s);
         }
+        delete s2e_tb;
     }
 }
 
@@ -2650,11 +3939,13 @@ void s2e_tb_alloc(S2E*, TranslationBlock *tb)
 void s2e_set_tb_function(S2E*, TranslationBlock *tb)
 {
     tb->s2e_tb->llvm_function = tb->llvm_function;
+    ++stats::translationBlockFunctions;
 }
 
 void s2e_tb_free(S2E* s2e, TranslationBlock *tb)
 {
     s2e->getExecutor()->unrefS2ETb(tb->s2e_tb);
+    tb->s2e_tb = NULL;
 }
 
 void s2e_flush_tlb_cache()
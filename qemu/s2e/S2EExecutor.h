@@ -40,6 +40,14 @@
 #include <llvm/Support/raw_ostream.h>
 #include <cpu.h>
 
+#include <s2e/Synchronization.h>
+#include <s2e/SolutionFuture.h>
+
+#include <deque>
+#include <set>
+#include <map>
+#include <cstdio>
+
 class TCGLLVMContext;
 
 struct TranslationBlock;
@@ -53,12 +61,37 @@ namespace s2e {
 
 class S2E;
 class S2EExecutionState;
+class SolverPool;
 struct S2ETranslationBlock;
+struct PathHashSet;
+struct PathNode;
+struct ReplayNode;
 
 class CpuExitException
 {
 };
 
+/** Fork accounting and budget of one guest program counter */
+struct ForkSite
+{
+    enum Policy {
+        STOP,      /* follow one outcome */
+        CONCRETIZE /* pin the data the condition reads */
+    };
+
+    uint64_t conditions; /* symbolic conditions evaluated at the site */
+    uint64_t forks;      /* both outcomes were feasible */
+    uint64_t infeasible; /* only one outcome was feasible */
+    uint64_t budgeted;   /* conditions seen after the budget was exhausted */
+    uint64_t solverTime; /* in microseconds */
+
+    uint64_t budget;     /* 0 means unlimited */
+    Policy policy;
+
+    ForkSite() : conditions(0), forks(0), infeasible(0), budgeted(0),
+                 solverTime(0), budget(0), policy(STOP) {}
+};
+
 /** Handler required for KLEE interpreter */
 class S2EHandler : public klee::InterpreterHandler
 {
@@ -115,6 +148,74 @@ protected:
     /** Holds the yielded state, if any */
     S2EExecutionState* yieldedState;
 
+    /** Path hashes reached by the states of all S2E processes */
+    S2ESynchronizedObject<PathHashSet> *m_pathHashes;
+
+    /** States found to follow an already explored path */
+    std::set<S2EExecutionState*> m_duplicatePathStates;
+
+    /** Checkpoint log of this process, opened at the first checkpoint */
+    FILE *m_checkpointFile;
+
+    /** Path nodes are written once per generation. A new generation
+        starts with each new checkpoint file. */
+    unsigned m_checkpointGeneration;
+    uint64_t m_nextCheckpointNodeId;
+    unsigned m_checkpointCount;
+    int64_t m_lastCheckpointTime;
+
+    /** Fork decisions of the checkpoint being resumed */
+    ReplayNode *m_replayRoot;
+    std::vector<ReplayNode*> m_replayNodes;
+
+    /** States that left the paths of the checkpoint being resumed */
+    std::set<S2EExecutionState*> m_replayPrunedStates;
+
+    /** States that plugins asked to terminate, with the reason */
+    std::map<S2EExecutionState*, std::string> m_pendingTerminations;
+
+    /** Fork statistics and budgets, indexed by guest pc */
+    std::map<uint64_t, ForkSite> m_forkSites;
+    bool m_forkSiteAccounting;
+
+    /** Path prefixes whose negated branch was already solved, see
+        generateSeeds */
+    std::set<uint64_t> m_negatedBranches;
+
+    /** Negated branch solved in the background, see generateSeeds */
+    struct PendingSeed {
+        SolutionFuture *future;
+        int stateId;
+        unsigned branch;
+        /** Concolic values of all symbolic arrays of the state */
+        SolutionFuture::ConcreteInputs concolics;
+    };
+    std::deque<PendingSeed> m_pendingSeeds;
+
+    /** Expressions concretized by limitExprComplexity, indexed by guest pc */
+    std::map<uint64_t, uint64_t> m_concretizedExprSites;
+
+    /** Background solver processes, started on the first request */
+    SolverPool *m_solverPool;
+
+    typedef std::vector<std::pair<std::string, const klee::Array*> > SolverObjects;
+
+    SolutionFuture *solveAsync(const std::vector<klee::ref<klee::Expr> > &constraints,
+                               const std::vector<klee::ref<klee::Expr> > &preferences,
+                               const SolverObjects &objects);
+    static void solveRequest(const std::vector<unsigned char> &request,
+                             std::vector<char> &reply);
+
+    void generateSeeds(S2EExecutionState &state);
+    void writeSeed(int stateId, unsigned branch,
+                   const SolutionFuture::ConcreteInputs &concolics,
+                   const SolutionFuture::ConcreteInputs &solution);
+    void completeSeeds(unsigned maxPending);
+
+    ForkSite &getForkSite(uint64_t pc);
+    klee::ref<klee::Expr> concretizeCondition(S2EExecutionState &state,
+                                              klee::ref<klee::Expr> condition);
+
     /** Moves yielded state back into list of schedulable states */
     void restoreYieldedState(void);
 
@@ -126,6 +227,12 @@ public:
 
     void flushTb();
 
+    /** Rewrites forksites.stats, called with each run.stats line */
+    void writeForkSiteStats();
+
+    /** Rewrites concretizedexprs.stats, called with each run.stats line */
+    void writeConcretizedExprStats();
+
     /** Create initial execution state */
     S2EExecutionState* createInitialState();
 
@@ -193,6 +300,21 @@ public:
     /** Puts back the previously suspended state in the queue */
     bool resumeState(S2EExecutionState *state, bool onlyAddToPtree = false);
 
+    /** Create count copies of the given state. The copies are identical
+        to it and do not get any additional path constraint. */
+    void cloneState(S2EExecutionState *state, unsigned count,
+                    std::vector<S2EExecutionState*> &clones);
+
+    /** Terminate a state other than the current one at the next state
+        switch. It is never scheduled before that. */
+    void terminateStateAtSwitch(S2EExecutionState *state,
+                                const std::string &message);
+
+    /** Compute the symbolic solution of the state in a background solver
+        process. The state may be terminated right away. Returns NULL if
+        no solver process could be started. The caller owns the future. */
+    SolutionFuture *getSymbolicSolutionAsync(S2EExecutionState &state);
+
     klee::Searcher *getSearcher() const {
         return searcher;
     }
@@ -282,6 +404,9 @@ protected:
 
     void deleteState(klee::ExecutionState *state);
 
+    void saveConcreteObject(S2EExecutionState *state,
+                            const klee::MemoryObject *mo);
+
     void doStateSwitch(S2EExecutionState* oldState,
                        S2EExecutionState* newState);
 
@@ -291,6 +416,23 @@ protected:
 
     void doLoadBalancing();
 
+    void bindFunctionAddresses(llvm::Constant *c);
+
+    void updatePathHashes(S2EExecutionState *state,
+                          const std::vector<S2EExecutionState*> &newStates,
+                          const std::vector<klee::ref<klee::Expr> > &conditions,
+                          const std::vector<unsigned> &directions);
+    void terminateDuplicatePaths();
+
+    void updateCheckpointPaths(S2EExecutionState *state,
+                               const std::vector<S2EExecutionState*> &newStates);
+    void terminateReplayPrunedStates();
+    void terminatePendingStates();
+    void checkpointIfNeeded();
+    void writeCheckpoint();
+    uint64_t writeCheckpointNode(PathNode *node);
+    bool loadCheckpoint(const std::string &fileName);
+
     /** Copy concrete values to their proper location, concretizing
         if necessary (most importantly it will concretize CPU registers.
         Note: this is required only to execute generated code,
@@ -323,6 +465,9 @@ protected:
     void notifyFork(klee::ExecutionState &originalState, klee::ref<klee::Expr> &condition,
                     StatePair &targets);
 
+    void notifyExprConcretized(klee::ExecutionState &state,
+                               const klee::ref<klee::Expr> &e);
+
     /** Kills the specified state and raises an exception to exit the cpu loop */
     virtual void terminateState(klee::ExecutionState &state);
 
@@ -416,9 +561,36 @@ protected:
                                                klee::KInstruction* target,
                                                std::vector< klee::ref<klee::Expr> > &args);
 
+    static bool accessBoundedSymbolicAddress(klee::Executor* executor,
+                                             klee::ExecutionState* state,
+                                             klee::KInstruction* target,
+                                             klee::ref<klee::Expr> address, unsigned mmu_idx,
+                                             bool isWrite, unsigned data_size,
+                                             klee::ref<klee::Expr> &value);
+
     void replaceExternalFunctionsWithSpecialHandlers();
     void disableConcreteLLVMHelpers();
 
+    /** Interpret the body of an overriden internal function, as if
+        no special handler was registered for it */
+    void executeOverridenFunction(klee::ExecutionState &state,
+                                  llvm::Function *function,
+                                  std::vector< klee::ref<klee::Expr> > &args);
+
+#ifdef TARGET_I386
+    static void handle_cc_compute_c(klee::Executor* executor,
+                        klee::ExecutionState* state,
+                        klee::KInstruction* target,
+                        std::vector< klee::ref<klee::Expr> > &args);
+
+    static void handle_cc_compute_all(klee::Executor* executor,
+                        klee::ExecutionState* state,
+                        klee::KInstruction* target,
+                        std::vector< klee::ref<klee::Expr> > &args);
+
+    void replaceFlagsHelpersWithSpecialHandlers();
+#endif
+
     struct HandlerInfo {
       const char *name;
       S2EExecutor::FunctionHandler handler;
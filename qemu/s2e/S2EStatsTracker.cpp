@@ -68,12 +68,23 @@ namespace stats {
     Statistic translationBlocksConcrete("TranslationBlocksConcrete", "TBsConcrete");
     Statistic translationBlocksKlee("TranslationBlocksKlee", "TBsKlee");
 
+    Statistic translationBlockFunctions("TranslationBlockFunctions", "TBFuncs");
+    Statistic translationBlockFunctionsErased("TranslationBlockFunctionsErased", "TBFuncsErased");
+
     Statistic cpuInstructions("CpuInstructions", "CpuI");
     Statistic cpuInstructionsConcrete("CpuInstructionsConcrete", "CpuIConcrete");
     Statistic cpuInstructionsKlee("CpuInstructionsKlee", "CpuIKlee");
 
     Statistic concreteModeTime("ConcreteModeTime", "ConcModeTime");
     Statistic symbolicModeTime("SymbolicModeTime", "SymbModeTime");
+
+    Statistic duplicatePaths("DuplicatePaths", "DupPaths");
+    Statistic duplicatePathDepth("DuplicatePathDepth", "DupPathDepth");
+
+    Statistic budgetedForks("BudgetedForks", "BudgForks");
+    Statistic boundedSymbolicAccesses("BoundedSymbolicAccesses", "BoundSymbAcc");
+    Statistic loggedBranches("LoggedBranches", "LogBr");
+    Statistic negatedBranches("NegatedBranches", "NegBr");
 } // namespace stats
 } // namespace klee
 
@@ -152,6 +163,8 @@ void S2EStatsTracker::writeStatsHeader() {
              << "'TranslationBlocks',"
              << "'TranslationBlocksConcrete',"
              << "'TranslationBlocksKlee',"
+             << "'TranslationBlockFunctionsLive',"
+             << "'TranslationBlockFunctionsErased',"
              << "'CpuInstructions',"
              << "'CpuInstructionsConcrete',"
              << "'CpuInstructionsKlee',"
@@ -165,6 +178,18 @@ void S2EStatsTracker::writeStatsHeader() {
              << "'ForkTime',"
              << "'ResolveTime',"
              << "'MemoryUsage',"
+             << "'DuplicatePaths',"
+             << "'DuplicatePathDepth',"
+             << "'BudgetedForks',"
+             << "'BoundedSymbolicAccesses',"
+             << "'Constants',"
+             << "'InternedConstants',"
+             << "'ConcretizedExprs',"
+             << "'SimplifierCacheHits',"
+             << "'SimplifierCacheMisses',"
+             << "'LoggedBranches',"
+             << "'NegatedBranches',"
+             << "'UniqueValueHits',"
              << ")\n";
   statsFile->flush();
 }
@@ -183,6 +208,9 @@ void S2EStatsTracker::writeStatsLine() {
              << "," << stats::translationBlocks
              << "," << stats::translationBlocksConcrete
              << "," << stats::translationBlocksKlee
+             << "," << stats::translationBlockFunctions -
+                       stats::translationBlockFunctionsErased
+             << "," << stats::translationBlockFunctionsErased
              << "," << stats::cpuInstructions
              << "," << stats::cpuInstructionsConcrete
              << "," << stats::cpuInstructionsKlee
@@ -196,8 +224,23 @@ void S2EStatsTracker::writeStatsLine() {
              << "," << stats::forkTime / 1000000.
              << "," << stats::resolveTime / 1000000.
              << "," << getProcessMemoryUsage() //sys::Process::GetTotalMemoryUsage()
+             << "," << stats::duplicatePaths
+             << "," << stats::duplicatePathDepth
+             << "," << stats::budgetedForks
+             << "," << stats::boundedSymbolicAccesses
+             << "," << stats::constants
+             << "," << executor.getConstantPoolSize()
+             << "," << stats::concretizedExprs
+             << "," << stats::simplifierCacheHits
+             << "," << stats::simplifierCacheMisses
+             << "," << stats::loggedBranches
+             << "," << stats::negatedBranches
+             << "," << stats::uniqueValueHits
              << ")\n";
   statsFile->flush();
+
+  static_cast<S2EExecutor&>(executor).writeForkSiteStats();
+  static_cast<S2EExecutor&>(executor).writeConcretizedExprStats();
 }
 
 S2EStateStats::S2EStateStats():
@@ -45,12 +45,23 @@ namespace stats {
     extern klee::Statistic translationBlocksConcrete;
     extern klee::Statistic translationBlocksKlee;
 
+    extern klee::Statistic translationBlockFunctions;
+    extern klee::Statistic translationBlockFunctionsErased;
+
     extern klee::Statistic cpuInstructions;
     extern klee::Statistic cpuInstructionsConcrete;
     extern klee::Statistic cpuInstructionsKlee;
 
     extern klee::Statistic concreteModeTime;
     extern klee::Statistic symbolicModeTime;
+
+    extern klee::Statistic duplicatePaths;
+    extern klee::Statistic duplicatePathDepth;
+
+    extern klee::Statistic budgetedForks;
+    extern klee::Statistic boundedSymbolicAccesses;
+    extern klee::Statistic loggedBranches;
+    extern klee::Statistic negatedBranches;
 } // namespace stats
 } // namespace klee
 
@@ -0,0 +1,422 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "SolutionFuture.h"
+#include "Utils.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace s2e {
+
+SolutionFuture::SolutionFuture(SolverPool *pool, unsigned worker)
+    : m_pool(pool), m_worker(worker), m_done(false)
+{
+}
+
+SolutionFuture::~SolutionFuture()
+{
+    if (!m_done) {
+        m_pool->stopWorker(m_pool->m_workers[m_worker]);
+    }
+}
+
+bool SolutionFuture::isReady()
+{
+    if (!m_done) {
+        m_pool->receive(m_pool->m_workers[m_worker]);
+    }
+    return m_done;
+}
+
+bool SolutionFuture::get(ConcreteInputs &out)
+{
+    if (!m_done) {
+        m_pool->waitForReply(m_worker);
+    }
+    return deserialize(m_data, out);
+}
+
+static bool readFully(int fd, void *buffer, size_t size)
+{
+    char *p = (char*) buffer;
+    while (size) {
+        ssize_t ret = read(fd, p, size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        p += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void *buffer, size_t size)
+{
+    const char *p = (const char*) buffer;
+    while (size) {
+        ssize_t ret = write(fd, p, size);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+        p += ret;
+        size -= ret;
+    }
+    return true;
+}
+
+SolverPool::SolverPool(unsigned size, SolveFunction solve)
+    : m_solve(solve), m_owner(getpid())
+{
+    Worker worker = { -1, -1, -1, NULL };
+    m_workers.resize(size ? size : 1, worker);
+}
+
+SolverPool::~SolverPool()
+{
+    if (!isOwner()) {
+        detach();
+        return;
+    }
+
+    foreach2(it, m_workers.begin(), m_workers.end()) {
+        stopWorker(*it);
+    }
+}
+
+bool SolverPool::isOwner() const
+{
+    return getpid() == m_owner;
+}
+
+void SolverPool::detach()
+{
+    foreach2(it, m_workers.begin(), m_workers.end()) {
+        if (it->pid < 0) {
+            continue;
+        }
+
+        close(it->requestFd);
+        close(it->replyFd);
+        if (it->future) {
+            it->future->m_done = true;
+            it->future->m_data.clear();
+        }
+
+        it->pid = it->requestFd = it->replyFd = -1;
+        it->future = NULL;
+    }
+}
+
+bool SolverPool::startWorker(Worker &worker)
+{
+    int requestFds[2], replyFds[2];
+    if (pipe(requestFds) < 0) {
+        return false;
+    }
+    if (pipe(replyFds) < 0) {
+        close(requestFds[0]);
+        close(requestFds[1]);
+        return false;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+
+    int pid = ::fork();
+    if (pid < 0) {
+        close(requestFds[0]);
+        close(requestFds[1]);
+        close(replyFds[0]);
+        close(replyFds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(requestFds[1]);
+        close(replyFds[0]);
+
+        /* The other workers must see the end of their pipe when S2E exits */
+        foreach2(it, m_workers.begin(), m_workers.end()) {
+            if (it->pid >= 0) {
+                close(it->requestFd);
+                close(it->replyFd);
+            }
+        }
+
+        runWorker(requestFds[0], replyFds[1]);
+
+        //Leave the files and shared memory of S2E alone
+        _exit(0);
+    }
+
+    close(requestFds[0]);
+    close(replyFds[1]);
+    fcntl(replyFds[0], F_SETFL, O_NONBLOCK);
+
+    worker.pid = pid;
+    worker.requestFd = requestFds[1];
+    worker.replyFd = replyFds[0];
+    worker.future = NULL;
+    return true;
+}
+
+/** Requests and replies are preceded by their size */
+void SolverPool::runWorker(int requestFd, int replyFd)
+{
+    for (;;) {
+        uint32_t size;
+        if (!readFully(requestFd, &size, sizeof(size))) {
+            return;
+        }
+
+        std::vector<unsigned char> request(size);
+        if (size && !readFully(requestFd, &request[0], size)) {
+            return;
+        }
+
+        std::vector<char> reply;
+        m_solve(request, reply);
+
+        size = reply.size();
+        if (!writeFully(replyFd, &size, sizeof(size)) ||
+                (size && !writeFully(replyFd, &reply[0], size))) {
+            return;
+        }
+    }
+}
+
+/** Kill the worker. Its pending future, if any, fails. */
+void SolverPool::stopWorker(Worker &worker)
+{
+    if (worker.pid < 0) {
+        return;
+    }
+
+    int status;
+    close(worker.requestFd);
+    close(worker.replyFd);
+    kill(worker.pid, SIGKILL);
+    while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    if (worker.future) {
+        worker.future->m_done = true;
+        worker.future->m_data.clear();
+    }
+
+    worker.pid = worker.requestFd = worker.replyFd = -1;
+    worker.future = NULL;
+}
+
+/** Collect the available part of the reply of the worker */
+void SolverPool::receive(Worker &worker)
+{
+    char buffer[4096];
+
+    while (worker.future) {
+        ssize_t ret = read(worker.replyFd, buffer, sizeof(buffer));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret < 0 && errno == EAGAIN) {
+            return;
+        } else if (ret <= 0) {
+            //The worker died
+            stopWorker(worker);
+            return;
+        }
+
+        SolutionFuture *future = worker.future;
+        std::vector<char> &data = future->m_data;
+        data.insert(data.end(), buffer, buffer + ret);
+
+        uint32_t size;
+        if (data.size() >= sizeof(size)) {
+            memcpy(&size, &data[0], sizeof(size));
+            if (data.size() - sizeof(size) == size) {
+                data.erase(data.begin(), data.begin() + sizeof(size));
+                future->m_done = true;
+                worker.future = NULL;
+            }
+        }
+    }
+}
+
+/** Wait until the given worker, or any busy worker if index is
+    negative, has replied */
+void SolverPool::waitForReply(int index)
+{
+    for (;;) {
+        std::vector<struct pollfd> fds;
+        for (unsigned i = 0; i < m_workers.size(); ++i) {
+            Worker &worker = m_workers[i];
+            if ((index >= 0 && (int) i != index) || !worker.future) {
+                continue;
+            }
+
+            receive(worker);
+            if (!worker.future) {
+                return;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = worker.replyFd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            fds.push_back(pfd);
+        }
+
+        if (fds.empty()) {
+            return;
+        }
+
+        poll(&fds[0], fds.size(), -1);
+    }
+}
+
+SolutionFuture *SolverPool::submit(const std::vector<unsigned char> &request)
+{
+    assert(isOwner());
+
+    int index = -1;
+    while (index < 0) {
+        bool busy = false;
+        for (unsigned i = 0; i < m_workers.size() && index < 0; ++i) {
+            if (m_workers[i].pid >= 0 && !m_workers[i].future) {
+                index = i;
+            }
+            busy |= m_workers[i].future != NULL;
+        }
+
+        for (unsigned i = 0; i < m_workers.size() && index < 0; ++i) {
+            if (m_workers[i].pid < 0 && startWorker(m_workers[i])) {
+                index = i;
+            }
+        }
+
+        if (index < 0) {
+            if (!busy) {
+                return NULL;
+            }
+            waitForReply(-1);
+        }
+    }
+
+    Worker &worker = m_workers[index];
+    uint32_t size = request.size();
+    if (!writeFully(worker.requestFd, &size, sizeof(size)) ||
+            (size && !writeFully(worker.requestFd, &request[0], size))) {
+        stopWorker(worker);
+        return NULL;
+    }
+
+    worker.future = new SolutionFuture(this, index);
+    return worker.future;
+}
+
+static void writeUint32(std::vector<char> &data, uint32_t value)
+{
+    const char *bytes = (const char*) &value;
+    data.insert(data.end(), bytes, bytes + sizeof(value));
+}
+
+static bool readUint32(const std::vector<char> &data, size_t &pos, uint32_t &value)
+{
+    if (data.size() - pos < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, &data[pos], sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+void SolutionFuture::serialize(const ConcreteInputs &inputs, std::vector<char> &data)
+{
+    writeUint32(data, inputs.size());
+    for (ConcreteInputs::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+        writeUint32(data, it->first.size());
+        data.insert(data.end(), it->first.begin(), it->first.end());
+        writeUint32(data, it->second.size());
+        data.insert(data.end(), it->second.begin(), it->second.end());
+    }
+}
+
+/** Returns false if the process did not write a complete solution */
+bool SolutionFuture::deserialize(const std::vector<char> &data, ConcreteInputs &inputs)
+{
+    size_t pos = 0;
+    uint32_t count;
+    if (!readUint32(data, pos, count)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t length;
+        if (!readUint32(data, pos, length) || data.size() - pos < length) {
+            return false;
+        }
+        std::string name(data.begin() + pos, data.begin() + pos + length);
+        pos += length;
+
+        if (!readUint32(data, pos, length) || data.size() - pos < length) {
+            return false;
+        }
+        std::vector<unsigned char> value(data.begin() + pos,
+                                         data.begin() + pos + length);
+        pos += length;
+
+        inputs.push_back(std::make_pair(name, value));
+    }
+
+    return pos == data.size();
+}
+
+}
@@ -0,0 +1,139 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2E_SOLUTIONFUTURE_H
+#define S2E_SOLUTIONFUTURE_H
+
+#include <string>
+#include <vector>
+
+namespace s2e {
+
+class SolverPool;
+
+/**
+ *  Symbolic solution of a state computed by a worker of a SolverPool, so
+ *  that the execution loop does not wait for the solver. Destroying a
+ *  pending future stops its worker.
+ */
+class SolutionFuture
+{
+public:
+    typedef std::pair<std::string, std::vector<unsigned char> > VarValuePair;
+    typedef std::vector<VarValuePair> ConcreteInputs;
+
+private:
+    friend class SolverPool;
+
+    SolverPool *m_pool;
+    unsigned m_worker;
+    bool m_done;
+    std::vector<char> m_data;
+
+    SolutionFuture(SolverPool *pool, unsigned worker);
+
+public:
+    ~SolutionFuture();
+
+    /** Collect the reply of the worker without blocking and return
+        true once it is complete */
+    bool isReady();
+
+    /** Wait for the reply and return the solution. Returns false
+        if no solution could be computed. */
+    bool get(ConcreteInputs &out);
+
+    static void serialize(const ConcreteInputs &inputs, std::vector<char> &data);
+    static bool deserialize(const std::vector<char> &data, ConcreteInputs &inputs);
+};
+
+/**
+ *  A bounded set of solver processes forked from S2E.
+ *
+ *  The workers are started on demand, up to the size of the pool, and are
+ *  reused for all requests. A request and its reply are opaque byte
+ *  strings sent through pipes. The worker passes each request to the
+ *  solve function, which returns the reply, and exits when the pipe is
+ *  closed. Submitting a request while all workers are busy waits for one
+ *  of them to reply.
+ *
+ *  Only the process that created the pool can use it. In a process
+ *  forked by S2E afterwards, the pool must be abandoned with detach().
+ */
+class SolverPool
+{
+public:
+    typedef void (*SolveFunction)(const std::vector<unsigned char> &request,
+                                  std::vector<char> &reply);
+
+private:
+    friend class SolutionFuture;
+
+    struct Worker {
+        int pid;
+        int requestFd;
+        int replyFd;
+        SolutionFuture *future;
+    };
+
+    SolveFunction m_solve;
+    std::vector<Worker> m_workers;
+    int m_owner;
+
+    bool startWorker(Worker &worker);
+    void runWorker(int requestFd, int replyFd);
+    void stopWorker(Worker &worker);
+    void receive(Worker &worker);
+    void waitForReply(int worker);
+
+public:
+    SolverPool(unsigned size, SolveFunction solve);
+
+    /** Stops all workers, pending futures fail */
+    ~SolverPool();
+
+    /** Returns NULL if no worker could be started */
+    SolutionFuture *submit(const std::vector<unsigned char> &request);
+
+    /** Close the pipes of the workers without stopping them */
+    void detach();
+
+    /** Whether the calling process created the pool */
+    bool isOwner() const;
+};
+
+}
+
+#endif
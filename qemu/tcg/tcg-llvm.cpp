@@ -1519,7 +1519,10 @@ void tcg_llvm_tb_alloc(TranslationBlock *tb)
 void tcg_llvm_tb_free(TranslationBlock *tb)
 {
     if(tb->llvm_function) {
+        tcg_llvm_ctx->getExecutionEngine()->freeMachineCodeForFunction(
+                tb->llvm_function);
         tb->llvm_function->eraseFromParent();
+        tb->llvm_function = NULL;
     }
 }
 